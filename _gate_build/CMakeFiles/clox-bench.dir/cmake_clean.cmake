@@ -0,0 +1,33 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/clox-bench.dir/bench/harness.c.o"
+  "CMakeFiles/clox-bench.dir/bench/harness.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/chunk.c.o"
+  "CMakeFiles/clox-bench.dir/src/chunk.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/compiler.c.o"
+  "CMakeFiles/clox-bench.dir/src/compiler.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/debug.c.o"
+  "CMakeFiles/clox-bench.dir/src/debug.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/loxb.c.o"
+  "CMakeFiles/clox-bench.dir/src/loxb.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/memory.c.o"
+  "CMakeFiles/clox-bench.dir/src/memory.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/object.c.o"
+  "CMakeFiles/clox-bench.dir/src/object.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/profiler.c.o"
+  "CMakeFiles/clox-bench.dir/src/profiler.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/scanner.c.o"
+  "CMakeFiles/clox-bench.dir/src/scanner.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/table.c.o"
+  "CMakeFiles/clox-bench.dir/src/table.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/value.c.o"
+  "CMakeFiles/clox-bench.dir/src/value.c.o.d"
+  "CMakeFiles/clox-bench.dir/src/vm.c.o"
+  "CMakeFiles/clox-bench.dir/src/vm.c.o.d"
+  "clox-bench"
+  "clox-bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/clox-bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,30 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/chunk.c" "CMakeFiles/clox.dir/src/chunk.c.o" "gcc" "CMakeFiles/clox.dir/src/chunk.c.o.d"
+  "/root/repo/src/compiler.c" "CMakeFiles/clox.dir/src/compiler.c.o" "gcc" "CMakeFiles/clox.dir/src/compiler.c.o.d"
+  "/root/repo/src/debug.c" "CMakeFiles/clox.dir/src/debug.c.o" "gcc" "CMakeFiles/clox.dir/src/debug.c.o.d"
+  "/root/repo/src/loxb.c" "CMakeFiles/clox.dir/src/loxb.c.o" "gcc" "CMakeFiles/clox.dir/src/loxb.c.o.d"
+  "/root/repo/src/main.c" "CMakeFiles/clox.dir/src/main.c.o" "gcc" "CMakeFiles/clox.dir/src/main.c.o.d"
+  "/root/repo/src/memory.c" "CMakeFiles/clox.dir/src/memory.c.o" "gcc" "CMakeFiles/clox.dir/src/memory.c.o.d"
+  "/root/repo/src/object.c" "CMakeFiles/clox.dir/src/object.c.o" "gcc" "CMakeFiles/clox.dir/src/object.c.o.d"
+  "/root/repo/src/profiler.c" "CMakeFiles/clox.dir/src/profiler.c.o" "gcc" "CMakeFiles/clox.dir/src/profiler.c.o.d"
+  "/root/repo/src/scanner.c" "CMakeFiles/clox.dir/src/scanner.c.o" "gcc" "CMakeFiles/clox.dir/src/scanner.c.o.d"
+  "/root/repo/src/table.c" "CMakeFiles/clox.dir/src/table.c.o" "gcc" "CMakeFiles/clox.dir/src/table.c.o.d"
+  "/root/repo/src/value.c" "CMakeFiles/clox.dir/src/value.c.o" "gcc" "CMakeFiles/clox.dir/src/value.c.o.d"
+  "/root/repo/src/vm.c" "CMakeFiles/clox.dir/src/vm.c.o" "gcc" "CMakeFiles/clox.dir/src/vm.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,33 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/clox.dir/src/chunk.c.o"
+  "CMakeFiles/clox.dir/src/chunk.c.o.d"
+  "CMakeFiles/clox.dir/src/compiler.c.o"
+  "CMakeFiles/clox.dir/src/compiler.c.o.d"
+  "CMakeFiles/clox.dir/src/debug.c.o"
+  "CMakeFiles/clox.dir/src/debug.c.o.d"
+  "CMakeFiles/clox.dir/src/loxb.c.o"
+  "CMakeFiles/clox.dir/src/loxb.c.o.d"
+  "CMakeFiles/clox.dir/src/main.c.o"
+  "CMakeFiles/clox.dir/src/main.c.o.d"
+  "CMakeFiles/clox.dir/src/memory.c.o"
+  "CMakeFiles/clox.dir/src/memory.c.o.d"
+  "CMakeFiles/clox.dir/src/object.c.o"
+  "CMakeFiles/clox.dir/src/object.c.o.d"
+  "CMakeFiles/clox.dir/src/profiler.c.o"
+  "CMakeFiles/clox.dir/src/profiler.c.o.d"
+  "CMakeFiles/clox.dir/src/scanner.c.o"
+  "CMakeFiles/clox.dir/src/scanner.c.o.d"
+  "CMakeFiles/clox.dir/src/table.c.o"
+  "CMakeFiles/clox.dir/src/table.c.o.d"
+  "CMakeFiles/clox.dir/src/value.c.o"
+  "CMakeFiles/clox.dir/src/value.c.o.d"
+  "CMakeFiles/clox.dir/src/vm.c.o"
+  "CMakeFiles/clox.dir/src/vm.c.o.d"
+  "clox"
+  "clox.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/clox.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,135 @@
+/*
+  Benchmark harness: runs each .lox script given on the command line in
+  a fresh VM, a few warmup runs first and then a set of timed runs, and
+  prints one CSV row per script so results can be diffed across commits:
+
+      benchmark,runs,mean_ms,stddev_ms,min_ms
+
+  Usage: clox-bench [-w warmups] [-r runs] script.lox...
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+#include "vm.h"
+
+#define DEFAULT_WARMUPS 2
+#define DEFAULT_RUNS 10
+
+static double nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static char* readSource(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open file '%s'\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  fseek(file, 0, SEEK_END);
+  size_t size = ftell(file);
+  rewind(file);
+
+  // SCANNER_PADDING: the scanner reads aligned 16-byte blocks and may
+  // run a few bytes past the terminator.
+  char* buffer = (char*)malloc(size + 1 + SCANNER_PADDING);
+  if (buffer == NULL) {
+    fprintf(stderr, "Not enough memory to read '%s'.\n", path);
+    exit(EXIT_FAILURE);
+  }
+  size_t read = fread(buffer, sizeof(char), size, file);
+  memset(buffer + read, 0, 1 + SCANNER_PADDING);
+  fclose(file);
+  return buffer;
+}
+
+static const char* baseName(const char* path) {
+  const char* slash = strrchr(path, '/');
+  return slash == NULL ? path : slash + 1;
+}
+
+// one full run: a fresh VM so interned strings and globals from
+// earlier runs can't skew later ones. Only interpret() is timed.
+static double timedRun(const char* path, const char* source) {
+  initVM();
+  double start = nowMs();
+  InterpretResult result = interpret(source);
+  double elapsed = nowMs() - start;
+  freeVM();
+
+  if (result != INTERPRET_OK) {
+    fprintf(stderr, "benchmark '%s' failed to run.\n", path);
+    exit(EXIT_FAILURE);
+  }
+  return elapsed;
+}
+
+static void runBenchmark(const char* path, int warmups, int runs) {
+  char* source = readSource(path);
+
+  for (int i = 0; i < warmups; i++) {
+    timedRun(path, source);
+  }
+
+  double* times = (double*)malloc(sizeof(double) * runs);
+  double total = 0.0;
+  double min = 0.0;
+  for (int i = 0; i < runs; i++) {
+    times[i] = timedRun(path, source);
+    total += times[i];
+    if (i == 0 || times[i] < min)
+      min = times[i];
+  }
+
+  double mean = total / runs;
+  double variance = 0.0;
+  for (int i = 0; i < runs; i++) {
+    double delta = times[i] - mean;
+    variance += delta * delta;
+  }
+  double stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0.0;
+
+  printf("%s,%d,%.3f,%.3f,%.3f\n", baseName(path), runs, mean, stddev, min);
+  fflush(stdout);
+
+  free(times);
+  free(source);
+}
+
+int main(int argc, char const* argv[]) {
+  int warmups = DEFAULT_WARMUPS;
+  int runs = DEFAULT_RUNS;
+
+  int first = 1;
+  while (first < argc && argv[first][0] == '-') {
+    if (strcmp(argv[first], "-w") == 0 && first + 1 < argc) {
+      warmups = atoi(argv[first + 1]);
+      first += 2;
+    } else if (strcmp(argv[first], "-r") == 0 && first + 1 < argc) {
+      runs = atoi(argv[first + 1]);
+      first += 2;
+    } else {
+      fprintf(stderr, "Usage: clox-bench [-w warmups] [-r runs] script...\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (first == argc || runs < 1) {
+    fprintf(stderr, "Usage: clox-bench [-w warmups] [-r runs] script...\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("benchmark,runs,mean_ms,stddev_ms,min_ms\n");
+  for (int i = first; i < argc; i++) {
+    runBenchmark(argv[i], warmups, runs);
+  }
+
+  return 0;
+}
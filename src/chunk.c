@@ -1,34 +1,106 @@
-#include "chunk.h"
-#include "memory.h"
-
-void initChunk(Chunk* chunk) {
-  chunk->count = 0;
-  chunk->capacity = 0;
-  chunk->code = NULL;
-  chunk->lines = NULL;
-  initValueArray(&chunk->constants);
-}
-
-void writeChunk(Chunk* chunk, uint8_t code, int line) {
-  if (chunk->count + 1 > chunk->capacity) {
-    int oldCapacity = chunk->capacity;
-    chunk->capacity = GROW_CAPACITY(chunk->capacity);
-    chunk->code =
-        GROW_ARRAY(chunk->code, uint8_t, oldCapacity, chunk->capacity);
-    chunk->lines = GROW_ARRAY(chunk->lines, int, oldCapacity, chunk->capacity);
-  }
-  chunk->lines[chunk->count] = line;
-  chunk->code[chunk->count++] = code;
-}
-
-void freeChunk(Chunk* chunk) {
-  FREE_ARRAY(chunk->code, uint8_t, chunk->capacity);
-  FREE_ARRAY(chunk->lines, int, chunk->capacity);
-  freeValueArray(&chunk->constants);
-  initChunk(chunk);
-}
-
-int addConstant(Chunk* chunk, Value value) {
-  writeValueArray(&chunk->constants, value);
-  return chunk->constants.count - 1;
-}
+#include "chunk.h"
+#include "memory.h"
+#include "vm.h"
+
+void initChunk(Chunk* chunk) {
+  chunk->count = 0;
+  chunk->capacity = 0;
+  chunk->code = NULL;
+  chunk->lines = NULL;
+  chunk->lineCount = 0;
+  chunk->lineCapacity = 0;
+  chunk->caches = NULL;
+  chunk->cacheCount = 0;
+  chunk->cacheCapacity = 0;
+  initValueArray(&chunk->constants);
+}
+
+void writeChunk(Chunk* chunk, uint8_t code, int line) {
+  if (chunk->count + 1 > chunk->capacity) {
+    int oldCapacity = chunk->capacity;
+    chunk->capacity = GROW_CAPACITY(chunk->capacity);
+    chunk->code =
+        GROW_ARRAY(chunk->code, uint8_t, oldCapacity, chunk->capacity);
+  }
+
+  // the line table only grows when the source line changes, so runs of
+  // bytes from one line cost a single entry.
+  if (chunk->lineCount == 0 ||
+      chunk->lines[chunk->lineCount - 1].line != line) {
+    if (chunk->lineCount + 1 > chunk->lineCapacity) {
+      int oldCapacity = chunk->lineCapacity;
+      chunk->lineCapacity = GROW_CAPACITY(oldCapacity);
+      chunk->lines =
+          GROW_ARRAY(chunk->lines, LineStart, oldCapacity, chunk->lineCapacity);
+    }
+    chunk->lines[chunk->lineCount].offset = (int)chunk->count;
+    chunk->lines[chunk->lineCount].line = line;
+    chunk->lineCount++;
+  }
+
+  chunk->code[chunk->count++] = code;
+}
+
+void truncateChunk(Chunk* chunk, int count) {
+  // keep the line table in step with the code: a run starting at or
+  // past the cut would leave getLine's offsets out of order once new
+  // bytes land there.
+  while (chunk->lineCount > 0 &&
+         chunk->lines[chunk->lineCount - 1].offset >= count) {
+    chunk->lineCount--;
+  }
+  chunk->count = count;
+}
+
+// binary-searches the run containing `offset`: the entry with the
+// largest starting offset that isn't past it.
+int getLine(Chunk* chunk, int offset) {
+  int low = 0;
+  int high = chunk->lineCount - 1;
+
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (chunk->lines[mid].offset <= offset) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return chunk->lineCount == 0 ? 0 : chunk->lines[low].line;
+}
+
+void freeChunk(Chunk* chunk) {
+  FREE_ARRAY(chunk->code, uint8_t, chunk->capacity);
+  FREE_ARRAY(chunk->lines, LineStart, chunk->lineCapacity);
+  FREE_ARRAY(chunk->caches, InlineCache, chunk->cacheCapacity);
+  freeValueArray(&chunk->constants);
+  initChunk(chunk);
+}
+
+int addConstant(Chunk* chunk, Value value) {
+  // growing the constant array can collect; park the value on the VM
+  // stack so it stays reachable until it's actually in the pool (it may
+  // not be referenced from anywhere else yet, e.g. a function object
+  // fresh out of endCompiler).
+  pushValue(&vm.stack, value);
+  writeValueArray(&chunk->constants, value);
+  popValue(&vm.stack);
+  return chunk->constants.count - 1;
+}
+
+// reserves a fresh (empty) inline cache slot and returns its index.
+int addInlineCache(Chunk* chunk) {
+  if (chunk->cacheCount + 1 > chunk->cacheCapacity) {
+    int oldCapacity = chunk->cacheCapacity;
+    chunk->cacheCapacity = GROW_CAPACITY(oldCapacity);
+    chunk->caches = GROW_ARRAY(chunk->caches, InlineCache, oldCapacity,
+                               chunk->cacheCapacity);
+  }
+
+  InlineCache* cache = &chunk->caches[chunk->cacheCount];
+  cache->callee = NULL;
+  cache->tableCap = -1;
+  cache->tableIndex = -1;
+  return chunk->cacheCount++;
+}
@@ -1,71 +1,150 @@
-#ifndef clox_chunk_h
-#define clox_chunk_h
-
-#include "common.h"
-#include "value.h"
-
-/*
-    CHUNK:
-    A chunk is a wrapper around an array of bytes or
-    op codes that are to be executed in the VM
-    A chunk also has a constant pool, which is an array of
-    values (doubles).
-
-    Whenever the VM comes across a OP_CONSTANT, the very next instruction
-    is an index of the constant to be loaded in the constant pool
-
-    OP_CONSTANT 1 would mean grab the first constant in this chunk's constant
-   pool
-
-    "int* line" parallels the opcode array.
-    an Op code with index i in the bytecode array occurs on line lines[i] in the
-    source file.
-*/
-
-typedef enum {
-  OP_RETURN,
-  OP_CONSTANT,
-  OP_NIL,
-  OP_NOT,
-  OP_TRUE,
-  OP_FALSE,
-  OP_EQUAL,
-  OP_LESS,
-  OP_GREATER,
-  OP_NEGATE,
-  OP_MULT,
-  OP_DIV,
-  OP_ADD,
-  OP_SUB,
-  OP_PRINT,
-  OP_POP,
-  OP_POPN,
-  OP_DEFINE_GLOBAL,
-  OP_GET_GLOBAL,
-  OP_SET_GLOBAL,
-  OP_SET_LOCAL,
-  OP_GET_LOCAL,
-  OP_JUMPZ,
-  OP_JUMP,
-  OP_LOOP,
-  OP_CALL,
-  OP_CLOSURE,
-  OP_GET_UPVALUE,
-  OP_SET_UPVALUE,
-  OP_CLOSE_UPVALUE
-} OpCode;
-
-typedef struct {
-  size_t count;
-  size_t capacity;
-  uint8_t* code;
-  ValueArray constants;
-  int* lines;
-} Chunk;
-
-void initChunk(Chunk* chunk);
-void freeChunk(Chunk* chunk);
-void writeChunk(Chunk* chunk, uint8_t code, int line);
-int addConstant(Chunk* chunk, Value constant);
-
+#ifndef clox_chunk_h
+#define clox_chunk_h
+
+#include "common.h"
+#include "value.h"
+
+/*
+    CHUNK:
+    A chunk is a wrapper around an array of bytes or
+    op codes that are to be executed in the VM
+    A chunk also has a constant pool, which is an array of
+    values (doubles).
+
+    Whenever the VM comes across a OP_CONSTANT, the very next instruction
+    is an index of the constant to be loaded in the constant pool
+
+    OP_CONSTANT 1 would mean grab the first constant in this chunk's constant
+   pool
+
+    Line information is run-length encoded: consecutive bytes from the
+    same source line share one LineStart entry, and getLine() recovers
+    the line for an offset with a binary search. Line data is only read
+    on the error path and in the disassembler, so it doesn't need to be
+    O(1) - it needs to be small.
+*/
+
+typedef enum {
+  OP_RETURN,
+  OP_CONSTANT,
+  OP_NIL,
+  OP_NOT,
+  OP_TRUE,
+  OP_FALSE,
+  OP_EQUAL,
+  OP_LESS,
+  OP_GREATER,
+  OP_NEGATE,
+  OP_MULT,
+  OP_DIV,
+  OP_ADD,
+  OP_SUB,
+  OP_PRINT,
+  OP_POP,
+  OP_POPN,
+  OP_DEFINE_GLOBAL,
+  OP_GET_GLOBAL,
+  OP_SET_GLOBAL,
+  OP_SET_LOCAL,
+  OP_GET_LOCAL,
+  OP_JUMPZ,
+  OP_JUMP,
+  OP_LOOP,
+  OP_CALL,
+  OP_CLOSURE,
+  OP_GET_UPVALUE,
+  OP_SET_UPVALUE,
+  OP_CLOSE_UPVALUE,
+  // slot-indexed globals: the operand is a direct index into the VM's
+  // dense global array instead of a name to hash. The named variants
+  // above remain for late-bound lookups once the slot space runs out.
+  OP_DEFINE_GLOBAL_SLOT,
+  OP_GET_GLOBAL_SLOT,
+  OP_SET_GLOBAL_SLOT,
+  // superinstructions produced by the compiler's peephole pass.
+  // the fused comparisons keep negation semantics (OP_GREATER_EQUAL is
+  // "not less", exactly what OP_LESS + OP_NOT computed).
+  OP_NOT_EQUAL,
+  OP_GREATER_EQUAL,
+  OP_LESS_EQUAL,
+  // OP_CONSTANT k + OP_ADD fused; operand is the constant index.
+  OP_ADD_CONST,
+  // a call in tail position (`return f(...);`): same operands as
+  // OP_CALL, but the current frame is reused instead of pushing a new
+  // one, so iterative recursion runs in constant frame space.
+  OP_TAIL_CALL,
+  // builds an ObjArray from the top N stack values; operand is N.
+  OP_ARRAY,
+  // array[index] load and store; operands come off the stack.
+  OP_INDEX_GET,
+  OP_INDEX_SET,
+  // 16-bit-operand variants, emitted once a pool index no longer fits
+  // in a byte. The byte forms stay the common case - the compiler
+  // deduplicates the pool, so most chunks never reach index 256.
+  OP_CONSTANT_LONG,
+  OP_DEFINE_GLOBAL_LONG,
+  OP_GET_GLOBAL_LONG,
+  OP_SET_GLOBAL_LONG,
+  // type-specialized variants the interpreter rewrites in at runtime
+  // (quickening); the compiler never emits them. Each deopts back to
+  // its generic opcode when the observed types stop holding.
+  OP_ADD_NUM,
+  OP_ADD_STR,
+  OP_LESS_NUM,
+  OP_GREATER_NUM,
+  // guards an inlined call: operands are the argument count, the
+  // constant holding the function whose body was spliced in, and a
+  // 16-bit forward offset to that body. Jumps into the splice when the
+  // value actually being called is still that function; falls through
+  // to an ordinary OP_CALL when the binding was reassigned.
+  OP_INLINE_GUARD
+} OpCode;
+
+/*
+  A per-site inline cache. The compiler reserves a 16-bit operand after
+  OP_CALL and OP_GET_GLOBAL that indexes this array; the VM fills the
+  slot in on first execution and takes a one-compare fast path while the
+  site stays monomorphic (which it almost always does).
+*/
+typedef struct {
+  // call sites: the last closure called from this site.
+  Obj* callee;
+  // named global loads: where the binding lived in vm.globals. The
+  // cache is stale (and re-probed) once the table has been resized or
+  // the entry's key no longer matches.
+  int tableCap;
+  int tableIndex;
+} InlineCache;
+
+// one run of bytecode from a single source line: bytes from `offset`
+// up to the next entry's offset were compiled from `line`.
+typedef struct {
+  int offset;
+  int line;
+} LineStart;
+
+typedef struct {
+  size_t count;
+  size_t capacity;
+  uint8_t* code;
+  ValueArray constants;
+  LineStart* lines;
+  int lineCount;
+  int lineCapacity;
+  InlineCache* caches;
+  int cacheCount;
+  int cacheCapacity;
+} Chunk;
+
+void initChunk(Chunk* chunk);
+void freeChunk(Chunk* chunk);
+void writeChunk(Chunk* chunk, uint8_t code, int line);
+// rolls the chunk back to `count` bytes, dropping line runs that start
+// at or past the cut; the compiler's peephole deletes folded
+// instructions with this.
+void truncateChunk(Chunk* chunk, int count);
+int getLine(Chunk* chunk, int offset);
+int addConstant(Chunk* chunk, Value constant);
+int addInlineCache(Chunk* chunk);
+
 #endif
\ No newline at end of file
@@ -1,13 +1,13 @@
-#ifndef clox_common_h
-#define clox_common_h
-
-#include <stdbool.h>
-#include <stddef.h>
-#include <stdint.h>
-
-#define DEBUG_PRINT_CODE
-// #define DEBUG_TRACE_EXECTUION
-#define DEBUG_STRESS_GC
-#define DEBUG_LOG_GC
-
+#ifndef clox_common_h
+#define clox_common_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// #define DEBUG_PRINT_CODE
+// #define DEBUG_TRACE_EXECTUION
+// #define DEBUG_STRESS_GC
+// #define DEBUG_LOG_GC
+
 #endif
\ No newline at end of file
@@ -1,929 +1,1645 @@
-#include "compiler.h"
-
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "common.h"
-#include "memory.h"
-#include "object.h"
-#include "scanner.h"
-#include "value.h"
-
-#ifdef DEBUG_PRINT_CODE
-#include "debug.h"
-#endif
-
-typedef struct {
-  Token previous;
-  Token current;
-  bool hadError;
-  bool panicMode;
-} Parser;
-
-typedef struct {
-  Token name;
-  int depth;
-  bool isCaptured;
-} Local;
-
-typedef struct {
-  uint8_t index;
-  bool isLocal;
-} Upvalue;
-
-typedef enum { TYPE_FUNCTION, TYPE_SCRIPT } FunctionType;
-
-typedef struct {
-  // the compiler outside this one.
-  // is NULL for the global scoped one.
-  struct Compiler* enclosing;
-  // the current function it
-  // compiles the bytecode into
-  ObjFunction* function;
-  FunctionType type;
-  // symbol table of local variables
-  Local locals[UINT8_MAX + 1];
-  int localCount;
-  // Upvalues captured in case this is a
-  // closure.
-  Upvalue upvalues[UINT8_MAX + 1];
-  int upvalueCount;
-  int scopeDepth;
-} Compiler;
-
-Parser parser;
-Compiler* current = NULL;
-Chunk* compilingChunk;
-
-// operator precedence
-
-// the enum values are in numerically
-// increasing order because of how
-// enums work
-
-typedef enum {
-  PREC_NONE,
-  PREC_ASSIGN,     // =
-  PREC_OR,         // or
-  PREC_AND,        // and
-  PREC_EQUALITY,   // ==
-  PREC_COMPARISON, // >= <= > <
-  PREC_TERM,       // + -
-  PREC_FACTOR,     // / * %
-  PREC_UNARY,      // - !
-  PREC_CALL,       // . ()
-  PREC_PRIMARY
-} Precedence;
-
-typedef void (*ParseFn)(bool canAssign);
-
-// A parse rule tells us the
-// function to call when encountering a token T
-typedef struct {
-  ParseFn prefix;
-  ParseFn infix;
-  Precedence precedence;
-} ParseRule;
-
-// helper functions
-
-static void errorAt(Token* token, const char* message) {
-  if (parser.panicMode)
-    return;
-  parser.panicMode = true;
-
-  fprintf(stderr, "[line %d] Error: ", token->line);
-
-  if (token->type == TOKEN_EOF) {
-    fprintf(stderr, " at end");
-  } else if (token->type == TOKEN_ERROR) {
-    // do nothing
-  } else {
-    fprintf(stderr, " at '%.*s'", token->length, token->start);
-  }
-  fprintf(stderr, " %s\n", message);
-  parser.hadError = true;
-}
-
-static void error(const char* message) { errorAt(&parser.current, message); }
-
-static void errorAtCurrent(const char* message) {
-  errorAt(&parser.current, message);
-}
-
-static void advance() {
-  parser.previous = parser.current;
-  // the while loop helps
-  // skip the error tokens
-  // that are produced by the lexer
-  while (true) {
-    parser.current = scanToken();
-    // break if the current token is not error
-    // if it is an error then report the error
-    // and eat following error tokens if any
-    if (parser.current.type != TOKEN_ERROR)
-      break;
-    errorAtCurrent(parser.current.start);
-  }
-}
-
-static void consume(TokenType type, const char* message) {
-  if (parser.current.type == type) {
-    advance();
-    return;
-  }
-  errorAtCurrent(message);
-}
-
-static Chunk* currentChunk() { return &current->function->chunk; }
-
-static void emitByte(uint8_t byte) {
-  writeChunk(currentChunk(), byte, parser.previous.line);
-}
-
-static void emitBytes(uint8_t byte1, uint8_t byte2) {
-  emitByte(byte1);
-  emitByte(byte2);
-}
-
-static void emitReturn() {
-  emitByte(OP_NIL);
-  emitByte(OP_RETURN);
-}
-
-static int emitJump(uint8_t instruction) {
-  emitByte(instruction);
-  // two place holder byte sized instructions
-  // that will be later strung together
-  // to make a short instruction. (16 bits)
-
-  emitByte(0xff);
-  emitByte(0xff);
-  // returns index of first byte
-  // of the jump address.
-  return currentChunk()->count - 2;
-}
-
-static void patchJump(int offset) {
-  int jump = currentChunk()->count - offset - 2;
-
-  if (jump > UINT16_MAX) {
-    error("Too much code to jump over.");
-  }
-
-  currentChunk()->code[offset] = (jump >> 8) & 0xff;
-  currentChunk()->code[offset + 1] = jump & 0xff;
-}
-
-static void emitLoop(int loopStart) {
-  emitByte(OP_LOOP);
-
-  int offset = currentChunk()->count - loopStart + 2;
-  if (offset > UINT16_MAX)
-    error("Loop body too large.");
-
-  emitByte((offset >> 8) & 0xff);
-  emitByte(offset & 0xff);
-}
-
-static uint8_t makeConstant(Value value) {
-  // addConstant returns the index in the pool to which
-  // the constant was added.
-  int constantIndex = addConstant(currentChunk(), value);
-
-  if (constantIndex > UINT8_MAX) {
-    error("Too many constants in one chunk.");
-    return 0;
-  }
-  return (uint8_t)constantIndex;
-}
-
-static void emitConstant(Value value) {
-  // first add the op_constant opcode
-  // then the index in the constant pool
-  // as it's operand (returned by makeConstant)
-  emitBytes(OP_CONSTANT, makeConstant(value));
-}
-
-static void initCompiler(Compiler* compiler, FunctionType type) {
-  compiler->enclosing = (struct Compiler*)current;
-  compiler->function = NULL;
-  compiler->localCount = 0;
-  compiler->scopeDepth = 0;
-  compiler->type = type;
-  compiler->function = newFunction();
-  current = compiler;
-
-  if (type != TYPE_SCRIPT) {
-    current->function->name =
-        copyString(parser.previous.start, parser.previous.length);
-  }
-
-  Local* local = &current->locals[current->localCount++];
-  local->depth = 0;
-  local->name.start = "";
-  local->name.length = 0;
-  local->isCaptured = false;
-}
-
-static ObjFunction* endCompiler() {
-  emitReturn();
-  ObjFunction* func = current->function;
-
-#ifdef DEBUG_PRINT_CODE
-  if (!parser.hadError) {
-    disassembleChunk(currentChunk(),
-                     func->name != NULL ? func->name->chars : "<script>");
-  }
-#endif
-
-  current = (Compiler*)current->enclosing;
-  return func;
-}
-
-static void beginScope() { current->scopeDepth++; }
-
-static void endScope() {
-  current->scopeDepth--;
-  uint8_t popCount = 0;
-
-  while (current->localCount > 0 &&
-         current->locals[current->localCount - 1].depth > current->scopeDepth) {
-    if (current->locals[current->localCount - 1].isCaptured) {
-      emitByte(OP_CLOSE_UPVALUE);
-    } else {
-      emitByte(OP_POP);
-    }
-    current->localCount--;
-  }
-}
-
-static bool check(TokenType type) { return parser.current.type == type; }
-
-static bool match(TokenType type) {
-  if (check(type)) {
-    advance();
-    return true;
-  }
-
-  return false;
-}
-
-// actual parsing functions and some forward declarations
-
-static void binary(bool canAssign);
-static void and (bool canAssign);
-static void or (bool canAssign);
-static void unary(bool canAssign);
-static void literal(bool canAssign);
-static void number(bool canAssign);
-static void string(bool canAssign);
-static void variable(bool canAssign);
-static void call(bool canAssign);
-static void namedVariable(Token name, bool canAssign);
-static void grouping(bool canAssign);
-static void expression();
-static void declaration();
-static void ifStatement();
-static void whileStatement();
-static void forStatement();
-static void statement();
-static void printStatement();
-static void expressionStatement();
-static void varDeclaration();
-static void funDeclaration();
-static void synchronize();
-static ParseRule* getRule(TokenType type);
-static void parsePrecedence(Precedence precedence);
-
-ParseRule rules[] = {
-    {grouping, call, PREC_CALL},     // TOKEN_LEFT_PAREN
-    {NULL, NULL, PREC_NONE},         // TOKEN_RIGHT_PAREN
-    {NULL, NULL, PREC_NONE},         // TOKEN_LEFT_BRACE
-    {NULL, NULL, PREC_NONE},         // TOKEN_RIGHT_BRACE
-    {NULL, NULL, PREC_NONE},         // TOKEN_COMMA
-    {NULL, NULL, PREC_NONE},         // TOKEN_DOT
-    {unary, binary, PREC_TERM},      // TOKEN_MINUS
-    {NULL, binary, PREC_TERM},       // TOKEN_PLUS
-    {NULL, NULL, PREC_NONE},         // TOKEN_SEMICOLON
-    {NULL, binary, PREC_FACTOR},     // TOKEN_SLASH
-    {NULL, binary, PREC_FACTOR},     // TOKEN_STAR
-    {unary, NULL, PREC_UNARY},       // TOKEN_BANG
-    {NULL, binary, PREC_COMPARISON}, // TOKEN_BANG_EQUAL
-    {NULL, NULL, PREC_NONE},         // TOKEN_EQUAL
-    {NULL, binary, PREC_EQUALITY},   // TOKEN_EQUAL_EQUAL
-    {NULL, binary, PREC_COMPARISON}, // TOKEN_GREATER
-    {NULL, binary, PREC_COMPARISON}, // TOKEN_GREATER_EQUAL
-    {NULL, binary, PREC_COMPARISON}, // TOKEN_LESS
-    {NULL, binary, PREC_COMPARISON}, // TOKEN_LESS_EQUAL
-    {variable, NULL, PREC_NONE},     // TOKEN_IDENTIFIER
-    {string, NULL, PREC_NONE},       // TOKEN_STRING
-    {number, NULL, PREC_NONE},       // TOKEN_NUMBER
-    {NULL, and, PREC_AND},           // TOKEN_AND
-    {NULL, NULL, PREC_NONE},         // TOKEN_CLASS
-    {NULL, NULL, PREC_NONE},         // TOKEN_ELSE
-    {literal, NULL, PREC_NONE},      // TOKEN_FALSE
-    {NULL, NULL, PREC_NONE},         // TOKEN_FOR
-    {NULL, NULL, PREC_NONE},         // TOKEN_FUN
-    {NULL, NULL, PREC_NONE},         // TOKEN_IF
-    {literal, NULL, PREC_NONE},      // TOKEN_NIL
-    {NULL, or, PREC_OR},             // TOKEN_OR
-    {NULL, NULL, PREC_NONE},         // TOKEN_PRINT
-    {NULL, NULL, PREC_NONE},         // TOKEN_RETURN
-    {NULL, NULL, PREC_NONE},         // TOKEN_SUPER
-    {NULL, NULL, PREC_NONE},         // TOKEN_THIS
-    {literal, NULL, PREC_NONE},      // TOKEN_TRUE
-    {NULL, NULL, PREC_NONE},         // TOKEN_VAR
-    {NULL, NULL, PREC_NONE},         // TOKEN_WHILE
-    {NULL, NULL, PREC_NONE},         // TOKEN_ERROR
-    {NULL, NULL, PREC_NONE},         // TOKEN_EOF
-};
-
-static ParseRule* getRule(TokenType type) { return &rules[type]; }
-
-static void parsePrecedence(Precedence precedence) {
-  advance();
-  ParseFn prefixRule = getRule(parser.previous.type)->prefix;
-
-  if (prefixRule == NULL) {
-    error("Expected expression");
-    return;
-  }
-
-  bool canAssign = precedence <= PREC_ASSIGN;
-  prefixRule(canAssign);
-
-  while (precedence <= getRule(parser.current.type)->precedence) {
-    advance();
-    ParseFn infixRule = getRule(parser.previous.type)->infix;
-    infixRule(canAssign);
-  }
-
-  if (canAssign && match(TOKEN_EQUAL)) {
-    error("Invalid assignment target.");
-  }
-}
-
-static uint8_t identifierConstant(Token* name) {
-  return makeConstant(OBJ_VAL(copyString(name->start, name->length)));
-}
-
-static bool identifiersEqual(Token* a, Token* b) {
-  if (a->length != b->length)
-    return false;
-  return memcmp(a->start, b->start, a->length) == 0;
-}
-
-static int addUpvalue(Compiler* compiler, uint8_t index, bool isLocal) {
-  int count = compiler->function->upvalueCount;
-
-  // check if this upvalue already exists.
-  for (int i = 0; i < count; i++) {
-    Upvalue* upvalue = &compiler->upvalues[i];
-    if (upvalue->index == index && upvalue->isLocal == isLocal)
-      return i;
-  }
-
-  if (count >= UINT8_MAX) {
-    error("Too many upvalues in a function.");
-    return -1;
-  }
-
-  // if none found, then add this as a new upvalue to the last
-  // slot, bump the upvalue count by 1 and return.
-
-  compiler->upvalues[count].index = index;
-  compiler->upvalues[count].isLocal = isLocal;
-
-  return compiler->function->upvalueCount++;
-}
-
-static int resolveLocal(Compiler* compiler, Token* name) {
-  for (int i = compiler->localCount - 1; i >= 0; i--) {
-    Local* local = &compiler->locals[i];
-
-    if (identifiersEqual(name, &(local->name))) {
-      if (local->depth == -1) {
-        error("Cannot read local variable in it's own initializer.");
-      }
-      return i;
-    }
-  }
-
-  return -1;
-}
-
-static int resolveUpvalue(Compiler* compiler, Token* name) {
-  Compiler* enclosing = (Compiler*)compiler->enclosing;
-  if (enclosing == NULL)
-    return -1;
-
-  int local = resolveLocal(enclosing, name);
-  bool isLocal = true;
-
-  if (local == -1) {
-    // if upvalue isn't found, look for an upvalue in the outer scope
-    // of the enclosing compiler
-    local = resolveUpvalue(enclosing, name);
-    // if no upvalue is found even in the chain of enclosing scopes
-    // exit.
-    if (local == -1)
-      return -1;
-    isLocal = false;
-  }
-  enclosing->locals[local].isCaptured = true;
-  return addUpvalue(compiler, (uint8_t)local, isLocal);
-}
-
-static void addLocal(Token name) {
-  if (current->localCount == UINT8_MAX + 1) {
-    error("Too many local variables in function.\n");
-    return;
-  }
-
-  Local* local = &current->locals[current->localCount++];
-  local->name = name;
-  local->depth = -1;
-  local->isCaptured = false;
-}
-
-static void declareVariable() {
-  // globals are implicitly declared
-  if (current->scopeDepth == 0)
-    return;
-
-  Token* name = &parser.previous;
-
-  for (int i = current->localCount - 1; i >= 0; i--) {
-    Local* local = &current->locals[i];
-    if (local->depth != -1 && local->depth < current->scopeDepth)
-      break;
-
-    if (identifiersEqual(name, &local->name)) {
-      error("Variable with this name already declared in this scope.");
-    }
-  }
-
-  addLocal(*name);
-}
-
-static uint8_t parseVariable(const char* errorMessage) {
-  consume(TOKEN_IDENTIFIER, errorMessage);
-  declareVariable();
-  if (current->scopeDepth > 0)
-    return 0;
-  return identifierConstant(&parser.previous);
-}
-
-static void markInitialized() {
-  if (current->scopeDepth == 0)
-    return;
-  current->locals[current->localCount - 1].depth = current->scopeDepth;
-}
-
-static void defineVariable(uint8_t global) {
-  if (current->scopeDepth > 0) {
-    markInitialized();
-    return;
-  }
-
-  emitBytes(OP_DEFINE_GLOBAL, global);
-}
-
-static void and (bool canAssign) {
-  // left operand has already been compiled
-  // and is at the top of the VM's stack
-  // at this time. so we jump to the
-  // right hand operand if it's false.
-  int lJump = emitJump(OP_JUMPZ);
-  emitByte(OP_POP);          // pop left operand, since it's falsy
-  parsePrecedence(PREC_AND); // op-codes for the right operand
-  patchJump(lJump);
-}
-
-static void or (bool canAssign) {
-  int elseJump = emitJump(OP_JUMPZ);
-  int endJump = emitJump(OP_JUMP);
-
-  patchJump(elseJump);
-  emitByte(OP_POP);
-
-  parsePrecedence(PREC_OR);
-  patchJump(endJump);
-}
-
-static void string(bool canAssign) {
-  emitConstant(OBJ_VAL(
-      copyString(parser.previous.start + 1, parser.previous.length - 2)));
-}
-
-static void namedVariable(Token name, bool canAssign) {
-  uint8_t getOp, setOp;
-  int arg = resolveLocal(current, &name);
-
-  if (arg != -1) {
-    getOp = OP_GET_LOCAL;
-    setOp = OP_SET_LOCAL;
-  } else if ((arg = resolveUpvalue(current, &name)) != -1) {
-    getOp = OP_GET_UPVALUE;
-    setOp = OP_SET_UPVALUE;
-  } else {
-    arg = identifierConstant(&name);
-    getOp = OP_GET_GLOBAL;
-    setOp = OP_SET_GLOBAL;
-  }
-
-  if (canAssign && match(TOKEN_EQUAL)) {
-    expression();
-    emitBytes(setOp, (uint8_t)arg);
-  } else {
-    emitBytes(getOp, (uint8_t)arg);
-  }
-}
-
-static void variable(bool canAssign) {
-  namedVariable(parser.previous, canAssign);
-}
-
-static void number(bool canAssign) {
-  double value = strtod(parser.previous.start, NULL);
-  emitConstant(NUMBER_VAL(value));
-}
-
-static void literal(bool canAssign) {
-  switch (parser.previous.type) {
-  case TOKEN_TRUE:
-    emitByte(OP_TRUE);
-    break;
-  case TOKEN_FALSE:
-    emitByte(OP_FALSE);
-    break;
-  case TOKEN_NIL:
-    emitByte(OP_NIL);
-    break;
-  case TOKEN_EQUAL_EQUAL:
-    emitByte(OP_EQUAL);
-    break;
-  default:
-    return; // Unreachable
-  }
-}
-
-static void expression() { parsePrecedence(PREC_ASSIGN); }
-
-static uint8_t parseArgs() {
-  uint8_t argCount = 0;
-  if (!check(TOKEN_RIGHT_PAREN)) {
-    do {
-      expression();
-      argCount++;
-      if (argCount >= UINT8_MAX) {
-        error("Cannot have more than 255 arguments.");
-      }
-
-    } while (match(TOKEN_COMMA));
-  }
-
-  consume(TOKEN_RIGHT_PAREN, "Expected ')' after argument list.");
-  return argCount;
-}
-
-static void call(bool canAssign) {
-  uint8_t argCount = parseArgs();
-  emitBytes(OP_CALL, argCount);
-}
-
-static void block() {
-  while (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
-    declaration();
-  }
-
-  consume(TOKEN_RIGHT_BRACE, "Expected '}' after block.");
-}
-
-static void declaration() {
-  if (match(TOKEN_VAR)) {
-    varDeclaration();
-  } else {
-    statement();
-  }
-  if (parser.panicMode)
-    synchronize();
-}
-
-static void varDeclaration() {
-  uint8_t global = parseVariable("Expected variable name.");
-
-  if (match(TOKEN_EQUAL)) {
-    expression();
-  } else {
-    emitByte(OP_NIL);
-  }
-
-  consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
-  defineVariable(global);
-}
-
-static void returnStatement() {
-  if (current->type == TYPE_SCRIPT) {
-    error("Cannot return from top-level code.");
-  }
-
-  if (match(TOKEN_SEMICOLON)) {
-    emitReturn();
-  } else {
-    expression();
-    consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
-    emitByte(OP_RETURN);
-  }
-}
-
-static void statement() {
-  if (match(TOKEN_FUN)) {
-    funDeclaration();
-  } else if (match(TOKEN_PRINT)) {
-    printStatement();
-  } else if (match(TOKEN_LEFT_BRACE)) {
-    beginScope();
-    block();
-    endScope();
-  } else if (match(TOKEN_IF)) {
-    ifStatement();
-  } else if (match(TOKEN_WHILE)) {
-    whileStatement();
-  } else if (match(TOKEN_FOR)) {
-    forStatement();
-  } else if (match(TOKEN_RETURN)) {
-    returnStatement();
-  } else {
-    expressionStatement();
-  }
-}
-
-static void function(FunctionType type) {
-  Compiler compiler;
-  initCompiler(&compiler, type);
-  beginScope();
-
-  // Compile parameter list
-  consume(TOKEN_LEFT_PAREN, "Expected '(' after function name.");
-  if (!check(TOKEN_RIGHT_PAREN)) {
-    do {
-      current->function->arity++;
-      if (current->function->arity > 255) {
-        errorAtCurrent("Cannot have more than 255 parameters.");
-      }
-
-      uint8_t paramConstant = parseVariable("Expect paramter name.");
-      defineVariable(paramConstant);
-    } while (check(TOKEN_COMMA));
-  }
-  consume(TOKEN_RIGHT_PAREN, "Expected ')' after function parameters.");
-
-  consume(TOKEN_LEFT_BRACE, "Expected '{' before function body.");
-  block();
-
-  ObjFunction* function = endCompiler();
-  emitBytes(OP_CLOSURE, makeConstant(OBJ_VAL(function)));
-
-  for (int i = 0; i < function->upvalueCount; i++) {
-    emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
-    emitByte(compiler.upvalues[i].index);
-  }
-}
-
-static void funDeclaration() {
-  uint8_t global = parseVariable("Expected function name.");
-  markInitialized();
-  function(TYPE_FUNCTION);
-  defineVariable(global);
-}
-
-static void printStatement() {
-  expression();
-  consume(TOKEN_SEMICOLON, "Expected ';' after value.");
-  emitByte(OP_PRINT);
-}
-
-static void expressionStatement() {
-  expression();
-  consume(TOKEN_SEMICOLON, "expected ';' after expression");
-  emitByte(OP_POP);
-}
-
-static void ifStatement() {
-  consume(TOKEN_LEFT_PAREN, "Expected '(' after 'if'");
-
-  // compile the condition.
-  expression();
-  consume(TOKEN_RIGHT_PAREN, "Expected ')' after if condition.");
-
-  int thenJump = emitJump(OP_JUMPZ);
-
-  // if the condition was true, pop it off the stack and run
-  // the statement body.
-  emitByte(OP_POP);
-  statement();
-
-  int elseJump = emitJump(OP_JUMP);
-
-  patchJump(thenJump);
-  emitByte(OP_POP);
-
-  if (match(TOKEN_ELSE))
-    statement();
-  patchJump(elseJump);
-}
-
-static void whileStatement() {
-  int loopStart = currentChunk()->count;
-
-  consume(TOKEN_LEFT_PAREN, "Expected '(' after 'while'.");
-  expression();
-  consume(TOKEN_RIGHT_PAREN, "Expected ')' after condition.");
-
-  int exitJump = emitJump(OP_JUMPZ);
-  emitByte(OP_POP);
-  statement();
-  emitLoop(loopStart);
-
-  patchJump(exitJump);
-  emitByte(OP_POP);
-}
-
-static void forStatement() {
-  beginScope();
-  consume(TOKEN_LEFT_PAREN, "Expected '(' after for.");
-
-  if (match(TOKEN_SEMICOLON)) {
-    // no initializer.
-  } else if (match(TOKEN_VAR)) {
-    varDeclaration();
-  } else {
-    expressionStatement();
-  }
-
-  int loopStart = currentChunk()->count;
-  int exitJmp = -1;
-
-  if (!match(TOKEN_SEMICOLON)) {
-    expression();
-    consume(TOKEN_SEMICOLON, "Expected ';'");
-    exitJmp = emitJump(OP_JUMPZ);
-    emitByte(OP_POP);
-  }
-
-  // increment.
-
-  if (!match(TOKEN_RIGHT_PAREN)) {
-    int bodyJmp = emitJump(OP_JUMP);
-    int incrStart = currentChunk()->count;
-    expression();
-    consume(TOKEN_RIGHT_PAREN, "Expected ')' after for-loop clause.");
-
-    emitByte(OP_POP);
-
-    emitLoop(loopStart);
-    loopStart = incrStart;
-    patchJump(bodyJmp);
-  }
-
-  statement();
-  emitLoop(loopStart);
-  endScope();
-
-  if (exitJmp != -1) {
-    patchJump(exitJmp);
-    emitByte(OP_POP); // pop the condition off the stack.
-  }
-}
-
-static void synchronize() {
-  parser.panicMode = false;
-
-  while (parser.current.type != TOKEN_EOF) {
-    if (parser.previous.type == TOKEN_SEMICOLON)
-      return;
-    switch (parser.current.type) {
-    case TOKEN_CLASS:
-    case TOKEN_FUN:
-    case TOKEN_VAR:
-    case TOKEN_FOR:
-    case TOKEN_IF:
-    case TOKEN_WHILE:
-    case TOKEN_PRINT:
-    case TOKEN_RETURN:
-      return;
-
-    default:;
-      // Do nothing.
-    }
-
-    advance();
-  }
-}
-
-static void binary(bool canAssign) {
-  TokenType operator= parser.previous.type;
-
-  //  Compile the right hand operand
-  ParseRule* rule = getRule(operator);
-  //  + 1 because binary operators like +, -, %, *
-  //  assosciate to the left , so 1 + 2 + 3
-  //  should be parsed as (1 + 2) + 3 instead of  1 + (2 + 3)
-  //  Each binary operator’s right-hand operand precedence is one level higher
-  //  than its own.
-  parsePrecedence((Precedence)(rule->precedence + 1));
-
-  //  Emit the operator instruction
-  switch (operator) {
-  case TOKEN_BANG_EQUAL:
-    emitBytes(OP_EQUAL, OP_NOT);
-    break;
-  case TOKEN_EQUAL_EQUAL:
-    emitByte(OP_EQUAL);
-    break;
-  case TOKEN_GREATER:
-    emitByte(OP_GREATER);
-    break;
-  case TOKEN_GREATER_EQUAL:
-    emitBytes(OP_LESS, OP_NOT);
-    break;
-  case TOKEN_LESS:
-    emitByte(OP_LESS);
-    break;
-  case TOKEN_LESS_EQUAL:
-    emitBytes(OP_GREATER, OP_NOT);
-    break;
-  case TOKEN_PLUS:
-    emitByte(OP_ADD);
-    break;
-  case TOKEN_MINUS:
-    emitByte(OP_SUB);
-    break;
-  case TOKEN_STAR:
-    emitByte(OP_MULT);
-    break;
-  case TOKEN_SLASH:
-    emitByte(OP_DIV);
-    break;
-  default:
-    return; // Unreachable.
-  }
-}
-
-static void unary(bool canAssign) {
-  TokenType operatorType = parser.previous.type;
-  // compile the operand
-  parsePrecedence(PREC_UNARY);
-  // emit the operator instruction.
-  switch (operatorType) {
-  case TOKEN_MINUS:
-    emitByte(OP_NEGATE);
-    break;
-  case TOKEN_BANG:
-    emitByte(OP_NOT);
-    break;
-  default:
-    return; // Unreachable
-  }
-}
-
-// assume the initial '(' is already consumed
-static void grouping(bool canAssign) {
-  expression();
-  consume(TOKEN_RIGHT_PAREN, "Expected ')' after expression.");
-}
-
-ObjFunction* compile(const char* source) {
-  initScanner(source);
-  Compiler compiler;
-  initCompiler(&compiler, TYPE_SCRIPT);
-  // initially both parser.current and parser.previous
-  // are set to nothing. calling it for the first time
-  // sets the current token to the first token in the
-  // source file, and sets the previous token to well.. nothing
-  advance();
-  // since the current token is now set to the first token
-  // in source, calling advance() now will set parser.previous
-  // to the first token in source and we can go from there.
-
-  // in clox, there is no buffer of tokens, so we just use
-  // parser.current instead of peek() to lookahead
-  while (!match(TOKEN_EOF)) {
-    declaration();
-  }
-
-  ObjFunction* function = endCompiler();
-  return parser.hadError ? NULL : function;
-}
-
-void markCompilerRoots() {
-  Compiler* compiler = current;
-  while (compiler != NULL) {
-    markObject((Obj*)compiler->function);
-    compiler = (Compiler*)compiler->enclosing;
-  }
+#include "compiler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "scanner.h"
+#include "value.h"
+#include "vm.h"
+
+#ifdef DEBUG_PRINT_CODE
+#include "debug.h"
+#endif
+
+typedef struct {
+  Token previous;
+  Token current;
+  bool hadError;
+  bool panicMode;
+} Parser;
+
+typedef struct {
+  Token name;
+  int depth;
+  bool isCaptured;
+} Local;
+
+typedef struct {
+  uint8_t index;
+  bool isLocal;
+} Upvalue;
+
+typedef enum { TYPE_FUNCTION, TYPE_SCRIPT } FunctionType;
+
+// how many patched jumps the threading ring remembers; chains deeper
+// than this just keep their extra hop.
+#define JUMP_THREAD_MAX 8
+
+typedef struct {
+  // the compiler outside this one.
+  // is NULL for the global scoped one.
+  struct Compiler* enclosing;
+  // the current function it
+  // compiles the bytecode into
+  ObjFunction* function;
+  FunctionType type;
+  // symbol table of local variables
+  Local locals[UINT8_MAX + 1];
+  int localCount;
+  // Upvalues captured in case this is a
+  // closure.
+  Upvalue upvalues[UINT8_MAX + 1];
+  int upvalueCount;
+  int scopeDepth;
+  // offset of the last opcode written, so the peephole in emitOp can
+  // rewrite it. -1 means "hands off": the next instruction can be a
+  // jump target, so fusing it with its predecessor would break jumps.
+  int lastOp;
+  // and the opcode before that one, for the three-instruction folds
+  // (constant, constant, arithmetic). Reset alongside lastOp.
+  int prevOp;
+  // ring of recently patched forward jumps (operand offset and landing
+  // site), so a jump that lands exactly on a later unconditional
+  // OP_JUMP can be re-patched straight to its final destination.
+  int threadSites[JUMP_THREAD_MAX];
+  int threadTargets[JUMP_THREAD_MAX];
+  int threadNext;
+  // operand-stack accounting: the depth the emitted code leaves the
+  // stack at, and the deepest point it reaches. endCompiler turns the
+  // high-water mark into ObjFunction.maxStack, which call() reserves
+  // in one go so the VM never bounds-checks individual pushes.
+  int stackDepth;
+  int maxStackDepth;
+} Compiler;
+
+// per-thread, like the VM itself: each isolate compiles independently.
+_Thread_local Parser parser;
+_Thread_local Compiler* current = NULL;
+_Thread_local Chunk* compilingChunk;
+
+// operator precedence
+
+// the enum values are in numerically
+// increasing order because of how
+// enums work
+
+typedef enum {
+  PREC_NONE,
+  PREC_ASSIGN,     // =
+  PREC_OR,         // or
+  PREC_AND,        // and
+  PREC_EQUALITY,   // ==
+  PREC_COMPARISON, // >= <= > <
+  PREC_TERM,       // + -
+  PREC_FACTOR,     // / * %
+  PREC_UNARY,      // - !
+  PREC_CALL,       // . ()
+  PREC_PRIMARY
+} Precedence;
+
+typedef void (*ParseFn)(bool canAssign);
+
+// A parse rule tells us the
+// function to call when encountering a token T
+typedef struct {
+  ParseFn prefix;
+  ParseFn infix;
+  Precedence precedence;
+} ParseRule;
+
+// helper functions
+
+static void errorAt(Token* token, const char* message) {
+  if (parser.panicMode)
+    return;
+  parser.panicMode = true;
+
+  fprintf(stderr, "[line %d] Error: ", token->line);
+
+  if (token->type == TOKEN_EOF) {
+    fprintf(stderr, " at end");
+  } else if (token->type == TOKEN_ERROR) {
+    // do nothing
+  } else {
+    fprintf(stderr, " at '%.*s'", token->length, token->start);
+  }
+  fprintf(stderr, " %s\n", message);
+  parser.hadError = true;
+}
+
+static void error(const char* message) { errorAt(&parser.current, message); }
+
+static void errorAtCurrent(const char* message) {
+  errorAt(&parser.current, message);
+}
+
+static void advance() {
+  parser.previous = parser.current;
+  // the while loop helps
+  // skip the error tokens
+  // that are produced by the lexer
+  while (true) {
+    parser.current = scanToken();
+    // break if the current token is not error
+    // if it is an error then report the error
+    // and eat following error tokens if any
+    if (parser.current.type != TOKEN_ERROR)
+      break;
+    errorAtCurrent(parser.current.start);
+  }
+}
+
+static void consume(TokenType type, const char* message) {
+  if (parser.current.type == type) {
+    advance();
+    return;
+  }
+  errorAtCurrent(message);
+}
+
+static Chunk* currentChunk() { return &current->function->chunk; }
+
+static void emitByte(uint8_t byte) {
+  writeChunk(currentChunk(), byte, parser.previous.line);
+}
+
+// marks the current offset as a potential jump target, so the peephole
+// below won't fuse the next instruction with anything emitted earlier.
+static void peepholeBarrier() {
+  current->lastOp = -1;
+  current->prevOp = -1;
+}
+
+// applies an emitted instruction's stack effect to the depth counter,
+// keeping the high-water mark current. The counter clamps at zero: a
+// branch's alternate path can pop values the tracked path already
+// popped, and patchJump re-syncs the depth at every merge point.
+static void adjustStack(int effect) {
+  current->stackDepth += effect;
+  if (current->stackDepth < 0)
+    current->stackDepth = 0;
+  if (current->stackDepth > current->maxStackDepth)
+    current->maxStackDepth = current->stackDepth;
+}
+
+// net stack effect of the fixed-effect opcodes. Variable-operand cases
+// (calls, OP_ARRAY) are handled at their emission sites, and the fused
+// superinstructions never go through here - their ingredients were
+// counted when they were requested.
+static int stackEffect(uint8_t op) {
+  switch (op) {
+  case OP_CONSTANT:
+  case OP_CONSTANT_LONG:
+  case OP_NIL:
+  case OP_TRUE:
+  case OP_FALSE:
+  case OP_GET_LOCAL:
+  case OP_GET_UPVALUE:
+  case OP_GET_GLOBAL:
+  case OP_GET_GLOBAL_LONG:
+  case OP_GET_GLOBAL_SLOT:
+  case OP_CLOSURE:
+    return 1;
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MULT:
+  case OP_DIV:
+  case OP_EQUAL:
+  case OP_LESS:
+  case OP_GREATER:
+  case OP_POP:
+  case OP_PRINT:
+  case OP_RETURN:
+  case OP_CLOSE_UPVALUE:
+  case OP_DEFINE_GLOBAL:
+  case OP_DEFINE_GLOBAL_LONG:
+  case OP_DEFINE_GLOBAL_SLOT:
+  case OP_INDEX_GET:
+    return -1;
+  case OP_INDEX_SET:
+    return -2;
+  default:
+    return 0;
+  }
+}
+
+static void emitConstant(Value value);
+static int makeConstant(Value value);
+
+// the three-instruction fold: both operands of an arithmetic opcode
+// are number constants just pushed back to back, so the arithmetic
+// happens at compile time and the two pushes collapse into one.
+static bool foldConstants(uint8_t op) {
+  Chunk* chunk = currentChunk();
+  int last = current->lastOp;
+  int prev = current->prevOp;
+  if (prev == -1 || last != (int)chunk->count - 2 || prev != last - 2)
+    return false;
+  if (chunk->code[last] != OP_CONSTANT || chunk->code[prev] != OP_CONSTANT)
+    return false;
+
+  Value a = chunk->constants.values[chunk->code[prev + 1]];
+  Value b = chunk->constants.values[chunk->code[last + 1]];
+  if (!IS_NUMBER(a) || !IS_NUMBER(b))
+    return false;
+
+  double result;
+  switch (op) {
+  case OP_ADD:
+    result = AS_NUMBER(a) + AS_NUMBER(b);
+    break;
+  case OP_SUB:
+    result = AS_NUMBER(a) - AS_NUMBER(b);
+    break;
+  case OP_MULT:
+    result = AS_NUMBER(a) * AS_NUMBER(b);
+    break;
+  case OP_DIV:
+    // IEEE division: folding 1/0 gives the same inf the VM would.
+    result = AS_NUMBER(a) / AS_NUMBER(b);
+    break;
+  default:
+    return false;
+  }
+
+  truncateChunk(chunk, prev);
+  current->lastOp = -1;
+  current->prevOp = -1;
+  // the two pushes were already tracked and the arithmetic's pop
+  // applied; re-emitting one constant re-adds the difference.
+  adjustStack(-1);
+  emitConstant(NUMBER_VAL(result));
+  return true;
+}
+
+/*
+  Emits an opcode, first giving a small peephole a chance to fold or
+  fuse it with what was just written:
+
+    OP_CONSTANT a + OP_CONSTANT b + <arith>      -> folded constant
+    OP_CONSTANT k + OP_NEGATE                    -> negated constant
+    OP_CONSTANT/OP_NIL/OP_TRUE/OP_FALSE + OP_POP -> nothing
+    OP_EQUAL/OP_LESS/OP_GREATER + OP_NOT  -> fused negated comparison
+    OP_CONSTANT k + OP_ADD                -> OP_ADD_CONST k
+    OP_POP + OP_POP (+ OP_POP...)         -> OP_POPN n
+
+  The peephole only looks at current->lastOp/prevOp, which are reset at
+  every jump target, so rewritten instructions can never straddle a
+  label.
+*/
+static void emitOp(uint8_t op) {
+  adjustStack(stackEffect(op));
+  Chunk* chunk = currentChunk();
+  int last = current->lastOp;
+
+  if (last != -1) {
+    uint8_t lastInstr = chunk->code[last];
+    switch (op) {
+    case OP_NOT:
+      if (last == (int)chunk->count - 1) {
+        if (lastInstr == OP_EQUAL) {
+          chunk->code[last] = OP_NOT_EQUAL;
+          return;
+        }
+        if (lastInstr == OP_LESS) {
+          chunk->code[last] = OP_GREATER_EQUAL;
+          return;
+        }
+        if (lastInstr == OP_GREATER) {
+          chunk->code[last] = OP_LESS_EQUAL;
+          return;
+        }
+      }
+      break;
+    case OP_NEGATE:
+      // rewrites the constant's operand in place; no code moves, so
+      // lastOp stays put and a fold can still pick the result up
+      // (`1 + -2` collapses completely).
+      if (lastInstr == OP_CONSTANT && last == (int)chunk->count - 2) {
+        Value v = chunk->constants.values[chunk->code[last + 1]];
+        if (IS_NUMBER(v)) {
+          int index = makeConstant(NUMBER_VAL(-AS_NUMBER(v)));
+          if (index <= UINT8_MAX) {
+            chunk->code[last + 1] = (uint8_t)index;
+            return;
+          }
+        }
+      }
+      break;
+    case OP_ADD:
+      if (foldConstants(op))
+        return;
+      if (lastInstr == OP_CONSTANT && last == (int)chunk->count - 2) {
+        chunk->code[last] = OP_ADD_CONST;
+        return;
+      }
+      break;
+    case OP_SUB:
+    case OP_MULT:
+    case OP_DIV:
+      if (foldConstants(op))
+        return;
+      break;
+    case OP_POP:
+      // a literal push followed immediately by a pop (an expression
+      // statement with no effect, or a scope closing right after its
+      // local's initializer) cancels out entirely.
+      if (lastInstr == OP_CONSTANT && last == (int)chunk->count - 2) {
+        truncateChunk(chunk, last);
+        current->lastOp = current->prevOp;
+        current->prevOp = -1;
+        return;
+      }
+      if ((lastInstr == OP_NIL || lastInstr == OP_TRUE ||
+           lastInstr == OP_FALSE) &&
+          last == (int)chunk->count - 1) {
+        truncateChunk(chunk, last);
+        current->lastOp = current->prevOp;
+        current->prevOp = -1;
+        return;
+      }
+      if (lastInstr == OP_POP && last == (int)chunk->count - 1) {
+        chunk->code[last] = OP_POPN;
+        emitByte(2);
+        return;
+      }
+      if (lastInstr == OP_POPN && last == (int)chunk->count - 2 &&
+          chunk->code[last + 1] < UINT8_MAX) {
+        chunk->code[last + 1]++;
+        return;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  current->prevOp = current->lastOp;
+  current->lastOp = chunk->count;
+  emitByte(op);
+}
+
+static void emitOpByte(uint8_t op, uint8_t operand) {
+  switch (op) {
+  case OP_CALL:
+  case OP_TAIL_CALL:
+    // the arguments are popped; the callee slot becomes the result.
+    adjustStack(-operand);
+    break;
+  case OP_ARRAY:
+    // peak first: the VM pushes the array on top of its elements
+    // before gathering them.
+    adjustStack(1);
+    adjustStack(-operand);
+    break;
+  default:
+    adjustStack(stackEffect(op));
+    break;
+  }
+  current->prevOp = current->lastOp;
+  current->lastOp = currentChunk()->count;
+  emitByte(op);
+  emitByte(operand);
+}
+
+static void emitReturn() {
+  emitOp(OP_NIL);
+  emitOp(OP_RETURN);
+}
+
+static int emitJump(uint8_t instruction) {
+  emitOp(instruction);
+  // two place holder byte sized instructions
+  // that will be later strung together
+  // to make a short instruction. (16 bits)
+  // Until patchJump overwrites them they stash the stack depth at the
+  // jump, so the merge point can re-sync depth tracking below.
+  emitByte((current->stackDepth >> 8) & 0xff);
+  emitByte(current->stackDepth & 0xff);
+  // returns index of first byte
+  // of the jump address.
+  return currentChunk()->count - 2;
+}
+
+static void patchJump(int offset) {
+  int jump = currentChunk()->count - offset - 2;
+
+  if (jump > UINT16_MAX) {
+    error("Too much code to jump over.");
+  }
+
+  // arriving via this jump the stack is as deep as it was when the
+  // jump was emitted, which can be deeper than the fall-through path
+  // the compiler just walked (it may have popped the condition).
+  int depthAtJump = (currentChunk()->code[offset] << 8) |
+                    currentChunk()->code[offset + 1];
+  if (depthAtJump > current->stackDepth)
+    current->stackDepth = depthAtJump;
+
+  currentChunk()->code[offset] = (jump >> 8) & 0xff;
+  currentChunk()->code[offset + 1] = jump & 0xff;
+
+  // jump threading: a jump patched earlier can land exactly on the
+  // unconditional OP_JUMP patched here (a nested if's exit jump
+  // arriving at the enclosing else-skip, say). Re-patch it straight to
+  // this jump's destination so the chain costs one hop at runtime.
+  Chunk* chunk = currentChunk();
+  int target = (int)chunk->count;
+  if (chunk->code[offset - 1] == OP_JUMP) {
+    for (int i = 0; i < JUMP_THREAD_MAX; i++) {
+      if (current->threadTargets[i] != offset - 1)
+        continue;
+      int site = current->threadSites[i];
+      int rejump = target - site - 2;
+      if (rejump <= UINT16_MAX) {
+        chunk->code[site] = (rejump >> 8) & 0xff;
+        chunk->code[site + 1] = rejump & 0xff;
+        // keep following the chain if this jump gets threaded too.
+        current->threadTargets[i] = target;
+      }
+    }
+  }
+  current->threadSites[current->threadNext] = offset;
+  current->threadTargets[current->threadNext] = target;
+  current->threadNext = (current->threadNext + 1) % JUMP_THREAD_MAX;
+
+  // whatever comes next is this jump's target.
+  peepholeBarrier();
+}
+
+static void emitLoop(int loopStart) {
+  emitOp(OP_LOOP);
+
+  int offset = currentChunk()->count - loopStart + 2;
+  if (offset > UINT16_MAX)
+    error("Loop body too large.");
+
+  emitByte((offset >> 8) & 0xff);
+  emitByte(offset & 0xff);
+}
+
+// opcode with a 16-bit big-endian operand (the layout READ_SHORT
+// decodes on the other end).
+static void emitOpShort(uint8_t op, uint16_t operand) {
+  adjustStack(stackEffect(op));
+  current->prevOp = current->lastOp;
+  current->lastOp = currentChunk()->count;
+  emitByte(op);
+  emitByte((operand >> 8) & 0xff);
+  emitByte(operand & 0xff);
+}
+
+// the dedup's notion of "same constant": numbers compare by bit
+// pattern, not numerically, because -0.0 == 0.0 under valuesEqual but
+// the two print differently (and 1 / -0 is -inf) - folding them onto
+// one slot would change observable output. Everything else keeps
+// valuesEqual; strings are interned, so that's a pointer compare.
+static bool constantsIdentical(Value a, Value b) {
+  if (IS_NUMBER(a) && IS_NUMBER(b)) {
+    double x = AS_NUMBER(a);
+    double y = AS_NUMBER(b);
+    return memcmp(&x, &y, sizeof(double)) == 0;
+  }
+  return valuesEqual(a, b);
+}
+
+static int makeConstant(Value value) {
+  // reuse an existing slot when the pool already holds an equal value:
+  // literals and identifier names repeat constantly, and deduplication
+  // keeps indices byte-sized (and the pool cache-dense) far longer.
+  ValueArray* constants = &currentChunk()->constants;
+  for (int i = 0; i < constants->count; i++) {
+    if (constantsIdentical(constants->values[i], value))
+      return i;
+  }
+
+  // addConstant returns the index in the pool to which
+  // the constant was added.
+  int constantIndex = addConstant(currentChunk(), value);
+  // the function under construction may already have been promoted by
+  // a minor collection mid-compile; a young constant stored into its
+  // pool must land in the remembered set or the next minor misses it.
+  gcWriteBarrier((Obj*)current->function, value);
+
+  if (constantIndex > UINT16_MAX) {
+    error("Too many constants in one chunk.");
+    return 0;
+  }
+  return constantIndex;
+}
+
+static void emitConstant(Value value) {
+  // first add the op_constant opcode
+  // then the index in the constant pool
+  // as it's operand (returned by makeConstant)
+  int index = makeConstant(value);
+  if (index <= UINT8_MAX) {
+    emitOpByte(OP_CONSTANT, (uint8_t)index);
+  } else {
+    emitOpShort(OP_CONSTANT_LONG, (uint16_t)index);
+  }
+}
+
+// reserves an inline cache slot for the instruction just emitted and
+// appends its 16-bit index as an extra operand.
+static void emitCacheOperand() {
+  int index = addInlineCache(currentChunk());
+  if (index > UINT16_MAX) {
+    error("Too many inline caches in one chunk.");
+    index = 0;
+  }
+  emitByte((index >> 8) & 0xff);
+  emitByte(index & 0xff);
+}
+
+/*
+  Small-function inlining. Completed functions whose bodies are tiny,
+  straight-line and capture nothing get registered as candidates; when
+  a later call site names one, the body is spliced into the caller
+  behind an OP_INLINE_GUARD instead of paying callValue's dispatch,
+  arity check and frame setup. The guard compares the value actually
+  being called against the spliced function at runtime and falls
+  through to an ordinary OP_CALL on a mismatch, so the splice is a bet,
+  not an assumption - reassigning or shadowing the name keeps Lox
+  semantics, it just runs at call speed.
+
+  The stack layout makes the splice cheap: at the call site the callee
+  value sits exactly where frame slot 0 would, with the arguments above
+  it, so the body's OP_GET_LOCAL/OP_SET_LOCAL slots map across by
+  adding one base offset and nothing else moves.
+*/
+
+#define INLINE_MAX_CANDIDATES 32
+#define INLINE_MAX_BYTECODE 24
+
+typedef struct {
+  ObjFunction* function;
+  // end of the spliced region: the offset of the first OP_RETURN.
+  int end;
+  // highest local slot the body touches, for remap bounds checks.
+  int maxSlot;
+  // values the body leaves above its frame base, result included.
+  int net;
+} InlineCandidate;
+
+static _Thread_local InlineCandidate inlineCandidates[INLINE_MAX_CANDIDATES];
+static _Thread_local int inlineCandidateCount = 0;
+// set by namedVariable when the identifier it just loaded names a
+// candidate and a '(' comes next; call() consumes it.
+static _Thread_local InlineCandidate* pendingInline = NULL;
+
+// walks a completed body and decides whether it can be spliced: only
+// straight-line code built from operand-stack opcodes, constants and
+// local/global-slot accesses, ending at its first OP_RETURN. Jumps,
+// calls (which also rules out recursion), closures and the named
+// global forms (their inline caches don't transplant) all disqualify.
+static bool analyzeInlineCandidate(ObjFunction* function,
+                                   InlineCandidate* out) {
+  Chunk* chunk = &function->chunk;
+  if ((int)chunk->count > INLINE_MAX_BYTECODE)
+    return false;
+
+  int net = 0;
+  int maxSlot = 0;
+  for (int i = 0; i < (int)chunk->count;) {
+    uint8_t op = chunk->code[i];
+    switch (op) {
+    case OP_RETURN:
+      // a result must be on top for the call site to keep.
+      if (net < 1)
+        return false;
+      out->function = function;
+      out->end = i;
+      out->maxSlot = maxSlot;
+      out->net = net;
+      return true;
+    case OP_NIL:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_NOT:
+    case OP_NEGATE:
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MULT:
+    case OP_DIV:
+    case OP_EQUAL:
+    case OP_LESS:
+    case OP_GREATER:
+    case OP_NOT_EQUAL:
+    case OP_GREATER_EQUAL:
+    case OP_LESS_EQUAL:
+    case OP_INDEX_GET:
+    case OP_INDEX_SET:
+    case OP_POP:
+    case OP_PRINT:
+      net += stackEffect(op);
+      i += 1;
+      break;
+    case OP_GET_LOCAL:
+    case OP_SET_LOCAL:
+      if (chunk->code[i + 1] > maxSlot)
+        maxSlot = chunk->code[i + 1];
+      net += stackEffect(op);
+      i += 2;
+      break;
+    case OP_CONSTANT:
+    case OP_ADD_CONST:
+    case OP_GET_GLOBAL_SLOT:
+    case OP_SET_GLOBAL_SLOT:
+      net += stackEffect(op);
+      i += 2;
+      break;
+    case OP_POPN:
+      net -= chunk->code[i + 1];
+      i += 2;
+      break;
+    case OP_ARRAY:
+      net += 1 - chunk->code[i + 1];
+      i += 2;
+      break;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+
+static void registerInlineCandidate(ObjFunction* function) {
+  if (inlineCandidateCount == INLINE_MAX_CANDIDATES)
+    return;
+  InlineCandidate* candidate = &inlineCandidates[inlineCandidateCount];
+  if (analyzeInlineCandidate(function, candidate))
+    inlineCandidateCount++;
+}
+
+// newest first, so a redeclaration's body wins the guess.
+static InlineCandidate* findInlineCandidate(Token* name) {
+  for (int i = inlineCandidateCount - 1; i >= 0; i--) {
+    ObjString* candidateName = inlineCandidates[i].function->name;
+    if (candidateName->length == name->length &&
+        memcmp(candidateName->chars, name->start, name->length) == 0) {
+      return &inlineCandidates[i];
+    }
+  }
+  return NULL;
+}
+
+static void initCompiler(Compiler* compiler, FunctionType type) {
+  compiler->enclosing = (struct Compiler*)current;
+  compiler->function = NULL;
+  compiler->localCount = 0;
+  compiler->scopeDepth = 0;
+  compiler->lastOp = -1;
+  compiler->prevOp = -1;
+  for (int i = 0; i < JUMP_THREAD_MAX; i++) {
+    compiler->threadTargets[i] = -1;
+  }
+  compiler->threadNext = 0;
+  compiler->stackDepth = 0;
+  compiler->maxStackDepth = 0;
+  compiler->type = type;
+  compiler->function = newFunction();
+  current = compiler;
+
+  if (type != TYPE_SCRIPT) {
+    current->function->name =
+        copyString(parser.previous.start, parser.previous.length);
+    gcWriteBarrier((Obj*)current->function,
+                   OBJ_VAL(current->function->name));
+  }
+
+  Local* local = &current->locals[current->localCount++];
+  local->depth = 0;
+  local->name.start = "";
+  local->name.length = 0;
+  local->isCaptured = false;
+}
+
+static ObjFunction* endCompiler() {
+  emitReturn();
+  ObjFunction* func = current->function;
+  // slot 0 holds the callee and the parameters sit above it; the
+  // body's deepest operand stack goes on top of that.
+  func->maxStack = 1 + func->arity + current->maxStackDepth;
+
+#ifdef DEBUG_PRINT_CODE
+  if (!parser.hadError) {
+    disassembleChunk(currentChunk(),
+                     func->name != NULL ? func->name->chars : "<script>");
+  }
+#endif
+
+  current = (Compiler*)current->enclosing;
+  return func;
+}
+
+static void beginScope() { current->scopeDepth++; }
+
+static void endScope() {
+  current->scopeDepth--;
+
+  while (current->localCount > 0 &&
+         current->locals[current->localCount - 1].depth > current->scopeDepth) {
+    if (current->locals[current->localCount - 1].isCaptured) {
+      emitOp(OP_CLOSE_UPVALUE);
+    } else {
+      emitOp(OP_POP);
+    }
+    current->localCount--;
+  }
+}
+
+static bool check(TokenType type) { return parser.current.type == type; }
+
+static bool match(TokenType type) {
+  if (check(type)) {
+    advance();
+    return true;
+  }
+
+  return false;
+}
+
+// actual parsing functions and some forward declarations
+
+static void binary(bool canAssign);
+static void and (bool canAssign);
+static void or (bool canAssign);
+static void unary(bool canAssign);
+static void literal(bool canAssign);
+static void number(bool canAssign);
+static void string(bool canAssign);
+static void variable(bool canAssign);
+static void call(bool canAssign);
+static void namedVariable(Token name, bool canAssign);
+static void grouping(bool canAssign);
+static void arrayLiteral(bool canAssign);
+static void subscript(bool canAssign);
+static void expression();
+static void declaration();
+static void ifStatement();
+static void whileStatement();
+static void forStatement();
+static void statement();
+static void printStatement();
+static void expressionStatement();
+static void varDeclaration();
+static void funDeclaration();
+static void synchronize();
+static ParseRule* getRule(TokenType type);
+static void parsePrecedence(Precedence precedence);
+
+ParseRule rules[] = {
+    {grouping, call, PREC_CALL},     // TOKEN_LEFT_PAREN
+    {NULL, NULL, PREC_NONE},         // TOKEN_RIGHT_PAREN
+    {NULL, NULL, PREC_NONE},         // TOKEN_LEFT_BRACE
+    {NULL, NULL, PREC_NONE},         // TOKEN_RIGHT_BRACE
+    {NULL, NULL, PREC_NONE},         // TOKEN_COMMA
+    {NULL, NULL, PREC_NONE},         // TOKEN_DOT
+    {unary, binary, PREC_TERM},      // TOKEN_MINUS
+    {NULL, binary, PREC_TERM},       // TOKEN_PLUS
+    {NULL, NULL, PREC_NONE},         // TOKEN_SEMICOLON
+    {NULL, binary, PREC_FACTOR},     // TOKEN_SLASH
+    {NULL, binary, PREC_FACTOR},     // TOKEN_STAR
+    {unary, NULL, PREC_UNARY},       // TOKEN_BANG
+    {NULL, binary, PREC_COMPARISON}, // TOKEN_BANG_EQUAL
+    {NULL, NULL, PREC_NONE},         // TOKEN_EQUAL
+    {NULL, binary, PREC_EQUALITY},   // TOKEN_EQUAL_EQUAL
+    {NULL, binary, PREC_COMPARISON}, // TOKEN_GREATER
+    {NULL, binary, PREC_COMPARISON}, // TOKEN_GREATER_EQUAL
+    {NULL, binary, PREC_COMPARISON}, // TOKEN_LESS
+    {NULL, binary, PREC_COMPARISON}, // TOKEN_LESS_EQUAL
+    {variable, NULL, PREC_NONE},     // TOKEN_IDENTIFIER
+    {string, NULL, PREC_NONE},       // TOKEN_STRING
+    {number, NULL, PREC_NONE},       // TOKEN_NUMBER
+    {NULL, and, PREC_AND},           // TOKEN_AND
+    {NULL, NULL, PREC_NONE},         // TOKEN_CLASS
+    {NULL, NULL, PREC_NONE},         // TOKEN_ELSE
+    {literal, NULL, PREC_NONE},      // TOKEN_FALSE
+    {NULL, NULL, PREC_NONE},         // TOKEN_FOR
+    {NULL, NULL, PREC_NONE},         // TOKEN_FUN
+    {NULL, NULL, PREC_NONE},         // TOKEN_IF
+    {literal, NULL, PREC_NONE},      // TOKEN_NIL
+    {NULL, or, PREC_OR},             // TOKEN_OR
+    {NULL, NULL, PREC_NONE},         // TOKEN_PRINT
+    {NULL, NULL, PREC_NONE},         // TOKEN_RETURN
+    {NULL, NULL, PREC_NONE},         // TOKEN_SUPER
+    {NULL, NULL, PREC_NONE},         // TOKEN_THIS
+    {literal, NULL, PREC_NONE},      // TOKEN_TRUE
+    {NULL, NULL, PREC_NONE},         // TOKEN_VAR
+    {NULL, NULL, PREC_NONE},         // TOKEN_WHILE
+    {NULL, NULL, PREC_NONE},         // TOKEN_ERROR
+    {NULL, NULL, PREC_NONE},         // TOKEN_EOF
+    {arrayLiteral, subscript, PREC_CALL}, // TOKEN_LEFT_BRACKET
+    {NULL, NULL, PREC_NONE},         // TOKEN_RIGHT_BRACKET
+};
+
+static ParseRule* getRule(TokenType type) { return &rules[type]; }
+
+static void parsePrecedence(Precedence precedence) {
+  advance();
+  ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+
+  if (prefixRule == NULL) {
+    error("Expected expression");
+    return;
+  }
+
+  bool canAssign = precedence <= PREC_ASSIGN;
+  prefixRule(canAssign);
+
+  while (precedence <= getRule(parser.current.type)->precedence) {
+    advance();
+    ParseFn infixRule = getRule(parser.previous.type)->infix;
+    // an inline guess only survives the direct variable -> call
+    // handoff; any other operator in between invalidates it.
+    if (infixRule != call)
+      pendingInline = NULL;
+    infixRule(canAssign);
+  }
+
+  if (canAssign && match(TOKEN_EQUAL)) {
+    error("Invalid assignment target.");
+  }
+}
+
+static int identifierConstant(Token* name) {
+  return makeConstant(OBJ_VAL(copyString(name->start, name->length)));
+}
+
+// resolves a global name to its dense slot on the VM, or -1 once the
+// slot space is exhausted (the caller falls back to named access).
+static int identifierSlot(Token* name) {
+  return globalSlot(copyString(name->start, name->length));
+}
+
+static bool identifiersEqual(Token* a, Token* b) {
+  if (a->length != b->length)
+    return false;
+  return memcmp(a->start, b->start, a->length) == 0;
+}
+
+static int addUpvalue(Compiler* compiler, uint8_t index, bool isLocal) {
+  int count = compiler->function->upvalueCount;
+
+  // check if this upvalue already exists.
+  for (int i = 0; i < count; i++) {
+    Upvalue* upvalue = &compiler->upvalues[i];
+    if (upvalue->index == index && upvalue->isLocal == isLocal)
+      return i;
+  }
+
+  if (count >= UINT8_MAX) {
+    error("Too many upvalues in a function.");
+    return -1;
+  }
+
+  // if none found, then add this as a new upvalue to the last
+  // slot, bump the upvalue count by 1 and return.
+
+  compiler->upvalues[count].index = index;
+  compiler->upvalues[count].isLocal = isLocal;
+
+  return compiler->function->upvalueCount++;
+}
+
+static int resolveLocal(Compiler* compiler, Token* name) {
+  for (int i = compiler->localCount - 1; i >= 0; i--) {
+    Local* local = &compiler->locals[i];
+
+    if (identifiersEqual(name, &(local->name))) {
+      if (local->depth == -1) {
+        error("Cannot read local variable in it's own initializer.");
+      }
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static int resolveUpvalue(Compiler* compiler, Token* name) {
+  Compiler* enclosing = (Compiler*)compiler->enclosing;
+  if (enclosing == NULL)
+    return -1;
+
+  int local = resolveLocal(enclosing, name);
+  bool isLocal = true;
+
+  if (local == -1) {
+    // if upvalue isn't found, look for an upvalue in the outer scope
+    // of the enclosing compiler
+    local = resolveUpvalue(enclosing, name);
+    // if no upvalue is found even in the chain of enclosing scopes
+    // exit.
+    if (local == -1)
+      return -1;
+    isLocal = false;
+  }
+  enclosing->locals[local].isCaptured = true;
+  return addUpvalue(compiler, (uint8_t)local, isLocal);
+}
+
+static void addLocal(Token name) {
+  if (current->localCount == UINT8_MAX + 1) {
+    error("Too many local variables in function.\n");
+    return;
+  }
+
+  Local* local = &current->locals[current->localCount++];
+  local->name = name;
+  local->depth = -1;
+  local->isCaptured = false;
+}
+
+static void declareVariable() {
+  // globals are implicitly declared
+  if (current->scopeDepth == 0)
+    return;
+
+  Token* name = &parser.previous;
+
+  for (int i = current->localCount - 1; i >= 0; i--) {
+    Local* local = &current->locals[i];
+    if (local->depth != -1 && local->depth < current->scopeDepth)
+      break;
+
+    if (identifiersEqual(name, &local->name)) {
+      error("Variable with this name already declared in this scope.");
+    }
+  }
+
+  addLocal(*name);
+}
+
+// the return value encodes how the global is addressed: a slot index
+// when non-negative, otherwise -(constantIndex + 1) for the named
+// fallback path. Locals always get 0, defineVariable ignores it.
+static int parseVariable(const char* errorMessage) {
+  consume(TOKEN_IDENTIFIER, errorMessage);
+  declareVariable();
+  if (current->scopeDepth > 0)
+    return 0;
+
+  int slot = identifierSlot(&parser.previous);
+  if (slot != -1)
+    return slot;
+  return -1 - (int)identifierConstant(&parser.previous);
+}
+
+static void markInitialized() {
+  if (current->scopeDepth == 0)
+    return;
+  current->locals[current->localCount - 1].depth = current->scopeDepth;
+}
+
+static void defineVariable(int global) {
+  if (current->scopeDepth > 0) {
+    markInitialized();
+    return;
+  }
+
+  if (global >= 0) {
+    emitOpByte(OP_DEFINE_GLOBAL_SLOT, (uint8_t)global);
+  } else {
+    int name = -1 - global;
+    if (name <= UINT8_MAX) {
+      emitOpByte(OP_DEFINE_GLOBAL, (uint8_t)name);
+    } else {
+      emitOpShort(OP_DEFINE_GLOBAL_LONG, (uint16_t)name);
+    }
+  }
+}
+
+static void and (bool canAssign) {
+  // left operand has already been compiled
+  // and is at the top of the VM's stack
+  // at this time. so we jump to the
+  // right hand operand if it's false.
+  int lJump = emitJump(OP_JUMPZ);
+  emitOp(OP_POP);            // pop left operand, since it's falsy
+  parsePrecedence(PREC_AND); // op-codes for the right operand
+  patchJump(lJump);
+}
+
+static void or (bool canAssign) {
+  int elseJump = emitJump(OP_JUMPZ);
+  int endJump = emitJump(OP_JUMP);
+
+  patchJump(elseJump);
+  emitOp(OP_POP);
+
+  parsePrecedence(PREC_OR);
+  patchJump(endJump);
+}
+
+static void string(bool canAssign) {
+  emitConstant(OBJ_VAL(
+      copyString(parser.previous.start + 1, parser.previous.length - 2)));
+}
+
+static void namedVariable(Token name, bool canAssign) {
+  uint8_t getOp, setOp;
+  int arg = resolveLocal(current, &name);
+
+  if (arg != -1) {
+    getOp = OP_GET_LOCAL;
+    setOp = OP_SET_LOCAL;
+  } else if ((arg = resolveUpvalue(current, &name)) != -1) {
+    getOp = OP_GET_UPVALUE;
+    setOp = OP_SET_UPVALUE;
+  } else if ((arg = identifierSlot(&name)) != -1) {
+    getOp = OP_GET_GLOBAL_SLOT;
+    setOp = OP_SET_GLOBAL_SLOT;
+  } else {
+    arg = identifierConstant(&name);
+    getOp = OP_GET_GLOBAL;
+    setOp = OP_SET_GLOBAL;
+  }
+
+  if (canAssign && match(TOKEN_EQUAL)) {
+    expression();
+    if (setOp == OP_SET_GLOBAL && arg > UINT8_MAX) {
+      emitOpShort(OP_SET_GLOBAL_LONG, (uint16_t)arg);
+    } else {
+      emitOpByte(setOp, (uint8_t)arg);
+    }
+  } else {
+    if (getOp == OP_GET_GLOBAL && arg > UINT8_MAX) {
+      // no inline cache past the byte range: these sites are the cold
+      // tail of chunks that already spilled 256 slots and 256 names.
+      emitOpShort(OP_GET_GLOBAL_LONG, (uint16_t)arg);
+    } else {
+      emitOpByte(getOp, (uint8_t)arg);
+      // named global loads carry an inline cache memoizing the entry's
+      // position in vm.globals.
+      if (getOp == OP_GET_GLOBAL)
+        emitCacheOperand();
+    }
+    // about to be called and the name matches a registered candidate:
+    // hand call() the guess to splice. Only a guess - the guard it
+    // emits keeps a reassigned or shadowed binding correct.
+    if (check(TOKEN_LEFT_PAREN))
+      pendingInline = findInlineCandidate(&name);
+  }
+}
+
+static void variable(bool canAssign) {
+  namedVariable(parser.previous, canAssign);
+}
+
+static void number(bool canAssign) {
+  double value = strtod(parser.previous.start, NULL);
+  emitConstant(NUMBER_VAL(value));
+}
+
+static void literal(bool canAssign) {
+  switch (parser.previous.type) {
+  case TOKEN_TRUE:
+    emitOp(OP_TRUE);
+    break;
+  case TOKEN_FALSE:
+    emitOp(OP_FALSE);
+    break;
+  case TOKEN_NIL:
+    emitOp(OP_NIL);
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    emitOp(OP_EQUAL);
+    break;
+  default:
+    return; // Unreachable
+  }
+}
+
+static void expression() { parsePrecedence(PREC_ASSIGN); }
+
+static uint8_t parseArgs() {
+  uint8_t argCount = 0;
+  if (!check(TOKEN_RIGHT_PAREN)) {
+    do {
+      expression();
+      argCount++;
+      if (argCount >= UINT8_MAX) {
+        error("Cannot have more than 255 arguments.");
+      }
+
+    } while (match(TOKEN_COMMA));
+  }
+
+  consume(TOKEN_RIGHT_PAREN, "Expected ')' after argument list.");
+  return argCount;
+}
+
+// splices a candidate's body into the caller at a call site whose
+// callee and arguments are already on the stack. See the block comment
+// at the candidate registry for the overall scheme.
+static void inlineCall(InlineCandidate* candidate, uint8_t argCount,
+                       int base, uint8_t expected) {
+  // OP_INLINE_GUARD argc const offset - emitted by hand because of the
+  // extra operands; like emitJump, the offset bytes stash the stack
+  // depth for patchJump to re-sync at the body label.
+  current->prevOp = current->lastOp;
+  current->lastOp = currentChunk()->count;
+  emitByte(OP_INLINE_GUARD);
+  emitByte(argCount);
+  emitByte(expected);
+  emitByte((current->stackDepth >> 8) & 0xff);
+  emitByte(current->stackDepth & 0xff);
+  int bodyJump = currentChunk()->count - 2;
+
+  // the fall-through: the guess was wrong, make the real call.
+  emitOpByte(OP_CALL, argCount);
+  emitCacheOperand();
+  int endJump = emitJump(OP_JUMP);
+
+  patchJump(bodyJump);
+  Chunk* body = &candidate->function->chunk;
+  for (int i = 0; i < candidate->end;) {
+    uint8_t op = body->code[i];
+    switch (op) {
+    case OP_CONSTANT:
+      // re-interned into the caller's pool; emitConstant picks the
+      // long form if this chunk's pool has already spilled a byte.
+      emitConstant(body->constants.values[body->code[i + 1]]);
+      i += 2;
+      break;
+    case OP_ADD_CONST: {
+      int index = makeConstant(body->constants.values[body->code[i + 1]]);
+      if (index <= UINT8_MAX) {
+        emitOpByte(OP_ADD_CONST, (uint8_t)index);
+      } else {
+        emitOpShort(OP_CONSTANT_LONG, (uint16_t)index);
+        emitOp(OP_ADD);
+      }
+      i += 2;
+      break;
+    }
+    case OP_GET_LOCAL:
+    case OP_SET_LOCAL:
+      // the one real translation: body slots land on top of the
+      // caller's live stack, callee value standing in for slot 0.
+      emitOpByte(op, (uint8_t)(base + body->code[i + 1]));
+      i += 2;
+      break;
+    case OP_POPN:
+      emitOpByte(op, body->code[i + 1]);
+      adjustStack(-body->code[i + 1]);
+      i += 2;
+      break;
+    case OP_ARRAY:
+    case OP_GET_GLOBAL_SLOT:
+    case OP_SET_GLOBAL_SLOT:
+      // global slots index the VM-wide array, identical from any chunk.
+      emitOpByte(op, body->code[i + 1]);
+      i += 2;
+      break;
+    default:
+      // the analyze pass only lets operand-less opcodes through here.
+      emitOp(op);
+      i += 1;
+      break;
+    }
+  }
+
+  // park the result in the callee's slot, then drop everything the
+  // splice stacked on top: the arguments, any body locals, and the
+  // result copy itself. Both paths leave just the result, exactly
+  // where OP_CALL's return would put it.
+  emitOpByte(OP_SET_LOCAL, (uint8_t)base);
+  int pops = argCount + candidate->net;
+  emitOpByte(OP_POPN, (uint8_t)pops);
+  adjustStack(-pops);
+  patchJump(endJump);
+}
+
+static void call(bool canAssign) {
+  InlineCandidate* candidate = pendingInline;
+  pendingInline = NULL;
+  // the frame-relative slot the callee value just landed in: slot 0 of
+  // the frame plus the arity-wide parameter band plus the operand
+  // depth before the callee was pushed.
+  int base = current->function->arity + current->stackDepth;
+  uint8_t argCount = parseArgs();
+
+  if (candidate != NULL && argCount == candidate->function->arity &&
+      base + candidate->maxSlot <= UINT8_MAX &&
+      argCount + candidate->net <= UINT8_MAX) {
+    int expected = makeConstant(OBJ_VAL(candidate->function));
+    if (expected <= UINT8_MAX) {
+      inlineCall(candidate, argCount, base, (uint8_t)expected);
+      return;
+    }
+  }
+
+  emitOpByte(OP_CALL, argCount);
+  // call sites carry an inline cache memoizing the resolved closure.
+  emitCacheOperand();
+}
+
+// [a, b, c]: the elements are compiled onto the stack left to right and
+// OP_ARRAY gathers them, so they stay rooted while the array allocates.
+static void arrayLiteral(bool canAssign) {
+  uint8_t count = 0;
+  if (!check(TOKEN_RIGHT_BRACKET)) {
+    do {
+      expression();
+      count++;
+      if (count >= UINT8_MAX) {
+        error("Cannot have more than 255 elements in an array literal.");
+      }
+    } while (match(TOKEN_COMMA));
+  }
+
+  consume(TOKEN_RIGHT_BRACKET, "Expected ']' after array elements.");
+  emitOpByte(OP_ARRAY, count);
+}
+
+static void subscript(bool canAssign) {
+  expression();
+  consume(TOKEN_RIGHT_BRACKET, "Expected ']' after index.");
+
+  if (canAssign && match(TOKEN_EQUAL)) {
+    expression();
+    emitOp(OP_INDEX_SET);
+  } else {
+    emitOp(OP_INDEX_GET);
+  }
+}
+
+static void block() {
+  while (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
+    declaration();
+  }
+
+  consume(TOKEN_RIGHT_BRACE, "Expected '}' after block.");
+}
+
+static void declaration() {
+  if (match(TOKEN_VAR)) {
+    varDeclaration();
+  } else {
+    statement();
+  }
+  if (parser.panicMode)
+    synchronize();
+}
+
+static void varDeclaration() {
+  int global = parseVariable("Expected variable name.");
+
+  if (match(TOKEN_EQUAL)) {
+    expression();
+  } else {
+    emitOp(OP_NIL);
+  }
+
+  consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
+  defineVariable(global);
+}
+
+static void returnStatement() {
+  if (current->type == TYPE_SCRIPT) {
+    error("Cannot return from top-level code.");
+  }
+
+  if (match(TOKEN_SEMICOLON)) {
+    emitReturn();
+  } else {
+    expression();
+    consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
+    // `return f(...);` - the call is in tail position, so the frame
+    // about to be popped can be handed straight to the callee. The
+    // OP_RETURN still follows as the return path for tail-called
+    // natives.
+    Chunk* chunk = currentChunk();
+    if (current->lastOp != -1 && chunk->code[current->lastOp] == OP_CALL &&
+        current->lastOp == (int)chunk->count - 4) {
+      chunk->code[current->lastOp] = OP_TAIL_CALL;
+    }
+    emitOp(OP_RETURN);
+  }
+}
+
+static void statement() {
+  if (match(TOKEN_FUN)) {
+    funDeclaration();
+  } else if (match(TOKEN_PRINT)) {
+    printStatement();
+  } else if (match(TOKEN_LEFT_BRACE)) {
+    beginScope();
+    block();
+    endScope();
+  } else if (match(TOKEN_IF)) {
+    ifStatement();
+  } else if (match(TOKEN_WHILE)) {
+    whileStatement();
+  } else if (match(TOKEN_FOR)) {
+    forStatement();
+  } else if (match(TOKEN_RETURN)) {
+    returnStatement();
+  } else {
+    expressionStatement();
+  }
+}
+
+static void function(FunctionType type) {
+  Compiler compiler;
+  initCompiler(&compiler, type);
+  beginScope();
+
+  // Compile parameter list
+  consume(TOKEN_LEFT_PAREN, "Expected '(' after function name.");
+  if (!check(TOKEN_RIGHT_PAREN)) {
+    do {
+      current->function->arity++;
+      if (current->function->arity > 255) {
+        errorAtCurrent("Cannot have more than 255 parameters.");
+      }
+
+      int paramConstant = parseVariable("Expect paramter name.");
+      defineVariable(paramConstant);
+      // match, not check: the comma has to be consumed or the next
+      // parseVariable sees it, errors, and this loop never advances.
+    } while (match(TOKEN_COMMA));
+  }
+  consume(TOKEN_RIGHT_PAREN, "Expected ')' after function parameters.");
+
+  consume(TOKEN_LEFT_BRACE, "Expected '{' before function body.");
+  block();
+
+  ObjFunction* function = endCompiler();
+  // no captured variables means nothing per-evaluation about the
+  // closure: the shared ObjFunction itself is loaded (and called)
+  // directly, eliding one heap allocation every time the expression
+  // runs. Only genuinely capturing functions pay for OP_CLOSURE.
+  if (function->upvalueCount == 0) {
+    // capture-free functions are also the only inlining candidates:
+    // their bodies read nothing but their own slots and globals.
+    registerInlineCandidate(function);
+    emitConstant(OBJ_VAL(function));
+    return;
+  }
+  // OP_CLOSURE keeps its byte operand: each function object is a
+  // distinct constant, so a chunk would need 256 of them to overflow.
+  int fnConstant = makeConstant(OBJ_VAL(function));
+  if (fnConstant > UINT8_MAX) {
+    error("Too many constants in one chunk.");
+    fnConstant = 0;
+  }
+  emitOpByte(OP_CLOSURE, (uint8_t)fnConstant);
+
+  for (int i = 0; i < function->upvalueCount; i++) {
+    emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
+    emitByte(compiler.upvalues[i].index);
+  }
+}
+
+static void funDeclaration() {
+  int global = parseVariable("Expected function name.");
+  markInitialized();
+  function(TYPE_FUNCTION);
+  defineVariable(global);
+}
+
+static void printStatement() {
+  expression();
+  consume(TOKEN_SEMICOLON, "Expected ';' after value.");
+  emitOp(OP_PRINT);
+}
+
+static void expressionStatement() {
+  expression();
+  consume(TOKEN_SEMICOLON, "expected ';' after expression");
+  emitOp(OP_POP);
+}
+
+static void ifStatement() {
+  consume(TOKEN_LEFT_PAREN, "Expected '(' after 'if'");
+
+  // compile the condition.
+  expression();
+  consume(TOKEN_RIGHT_PAREN, "Expected ')' after if condition.");
+
+  int thenJump = emitJump(OP_JUMPZ);
+
+  // if the condition was true, pop it off the stack and run
+  // the statement body.
+  emitOp(OP_POP);
+  statement();
+
+  int elseJump = emitJump(OP_JUMP);
+
+  patchJump(thenJump);
+  emitOp(OP_POP);
+
+  if (match(TOKEN_ELSE))
+    statement();
+  patchJump(elseJump);
+}
+
+static void whileStatement() {
+  int loopStart = currentChunk()->count;
+  peepholeBarrier();
+
+  consume(TOKEN_LEFT_PAREN, "Expected '(' after 'while'.");
+  expression();
+  consume(TOKEN_RIGHT_PAREN, "Expected ')' after condition.");
+
+  int exitJump = emitJump(OP_JUMPZ);
+  emitOp(OP_POP);
+  statement();
+  emitLoop(loopStart);
+
+  patchJump(exitJump);
+  emitOp(OP_POP);
+}
+
+static void forStatement() {
+  beginScope();
+  consume(TOKEN_LEFT_PAREN, "Expected '(' after for.");
+
+  if (match(TOKEN_SEMICOLON)) {
+    // no initializer.
+  } else if (match(TOKEN_VAR)) {
+    varDeclaration();
+  } else {
+    expressionStatement();
+  }
+
+  int loopStart = currentChunk()->count;
+  peepholeBarrier();
+  int exitJmp = -1;
+
+  if (!match(TOKEN_SEMICOLON)) {
+    expression();
+    consume(TOKEN_SEMICOLON, "Expected ';'");
+    exitJmp = emitJump(OP_JUMPZ);
+    emitOp(OP_POP);
+  }
+
+  // increment.
+
+  if (!match(TOKEN_RIGHT_PAREN)) {
+    int bodyJmp = emitJump(OP_JUMP);
+    int incrStart = currentChunk()->count;
+    peepholeBarrier();
+    expression();
+    consume(TOKEN_RIGHT_PAREN, "Expected ')' after for-loop clause.");
+
+    emitOp(OP_POP);
+
+    emitLoop(loopStart);
+    loopStart = incrStart;
+    patchJump(bodyJmp);
+  }
+
+  statement();
+  emitLoop(loopStart);
+  endScope();
+
+  if (exitJmp != -1) {
+    patchJump(exitJmp);
+    emitOp(OP_POP); // pop the condition off the stack.
+  }
+}
+
+static void synchronize() {
+  parser.panicMode = false;
+
+  while (parser.current.type != TOKEN_EOF) {
+    if (parser.previous.type == TOKEN_SEMICOLON)
+      return;
+    switch (parser.current.type) {
+    case TOKEN_CLASS:
+    case TOKEN_FUN:
+    case TOKEN_VAR:
+    case TOKEN_FOR:
+    case TOKEN_IF:
+    case TOKEN_WHILE:
+    case TOKEN_PRINT:
+    case TOKEN_RETURN:
+      return;
+
+    default:;
+      // Do nothing.
+    }
+
+    advance();
+  }
+}
+
+static void binary(bool canAssign) {
+  TokenType operator= parser.previous.type;
+
+  //  Compile the right hand operand
+  ParseRule* rule = getRule(operator);
+  //  + 1 because binary operators like +, -, %, *
+  //  assosciate to the left , so 1 + 2 + 3
+  //  should be parsed as (1 + 2) + 3 instead of  1 + (2 + 3)
+  //  Each binary operator’s right-hand operand precedence is one level higher
+  //  than its own.
+  parsePrecedence((Precedence)(rule->precedence + 1));
+
+  //  Emit the operator instruction
+  switch (operator) {
+  case TOKEN_BANG_EQUAL:
+    emitOp(OP_EQUAL);
+    emitOp(OP_NOT);
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    emitOp(OP_EQUAL);
+    break;
+  case TOKEN_GREATER:
+    emitOp(OP_GREATER);
+    break;
+  case TOKEN_GREATER_EQUAL:
+    emitOp(OP_LESS);
+    emitOp(OP_NOT);
+    break;
+  case TOKEN_LESS:
+    emitOp(OP_LESS);
+    break;
+  case TOKEN_LESS_EQUAL:
+    emitOp(OP_GREATER);
+    emitOp(OP_NOT);
+    break;
+  case TOKEN_PLUS:
+    emitOp(OP_ADD);
+    break;
+  case TOKEN_MINUS:
+    emitOp(OP_SUB);
+    break;
+  case TOKEN_STAR:
+    emitOp(OP_MULT);
+    break;
+  case TOKEN_SLASH:
+    emitOp(OP_DIV);
+    break;
+  default:
+    return; // Unreachable.
+  }
+}
+
+static void unary(bool canAssign) {
+  TokenType operatorType = parser.previous.type;
+  // compile the operand
+  parsePrecedence(PREC_UNARY);
+  // emit the operator instruction.
+  switch (operatorType) {
+  case TOKEN_MINUS:
+    emitOp(OP_NEGATE);
+    break;
+  case TOKEN_BANG:
+    emitOp(OP_NOT);
+    break;
+  default:
+    return; // Unreachable
+  }
+}
+
+// assume the initial '(' is already consumed
+static void grouping(bool canAssign) {
+  expression();
+  consume(TOKEN_RIGHT_PAREN, "Expected ')' after expression.");
+}
+
+ObjFunction* compile(const char* source) {
+  initScanner(source);
+  // candidates don't cross compilations: a REPL line may call into
+  // functions whose chunks have already run (and been quickened).
+  inlineCandidateCount = 0;
+  pendingInline = NULL;
+  Compiler compiler;
+  initCompiler(&compiler, TYPE_SCRIPT);
+  // initially both parser.current and parser.previous
+  // are set to nothing. calling it for the first time
+  // sets the current token to the first token in the
+  // source file, and sets the previous token to well.. nothing
+  advance();
+  // since the current token is now set to the first token
+  // in source, calling advance() now will set parser.previous
+  // to the first token in source and we can go from there.
+
+  // in clox, there is no buffer of tokens, so we just use
+  // parser.current instead of peek() to lookahead
+  while (!match(TOKEN_EOF)) {
+    declaration();
+  }
+
+  ObjFunction* function = endCompiler();
+  return parser.hadError ? NULL : function;
+}
+
+void markCompilerRoots() {
+  Compiler* compiler = current;
+  while (compiler != NULL) {
+    markObject((Obj*)compiler->function);
+    compiler = (Compiler*)compiler->enclosing;
+  }
 }
\ No newline at end of file
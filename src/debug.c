@@ -1,130 +1,191 @@
-#include "debug.h"
-
-#include "object.h"
-#include "value.h"
-#include <stdio.h>
-
-void disassembleChunk(Chunk* chunk, const char* name) {
-  printf("== %s ==\n\n", name);
-  for (int offset = 0; offset < chunk->count;) {
-    offset = disassembleInstruction(chunk, offset);
-  }
-}
-
-static int simpleInstruction(const char* name, int offset) {
-  printf("%s\n", name);
-  return offset + 1;
-}
-
-static int constantInstruction(const char* name, Chunk* chunk, int offset) {
-  uint8_t index = chunk->code[offset + 1];
-  Value constant = chunk->constants.values[index];
-  printf("%-16s\t%4d '", name, index);
-  printValue(constant);
-  printf("'\n");
-  return offset + 2;
-}
-
-static int byteInstruction(const char* name, Chunk* chunk, int offset) {
-  uint8_t slot = chunk->code[offset + 1];
-  printf("%-16s\t%4d\n", name, slot);
-  return offset + 2;
-}
-
-static int jumpInstruction(char* name, Chunk* chunk, int offset) {
-  uint8_t low = chunk->code[offset + 1];
-  uint8_t high = chunk->code[offset + 2];
-
-  uint16_t slot = (uint16_t)((low << 8) | (high & 0xff));
-  printf("%-16s\t%4d\n", name, slot);
-  return offset + 3;
-}
-
-int disassembleInstruction(Chunk* chunk, int offset) {
-  printf("%04d\t", offset);
-  if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1])
-    printf("   | ");
-  else
-    printf("%4d ", chunk->lines[offset]);
-
-  uint8_t instruction = chunk->code[offset];
-  switch (instruction) {
-  case OP_RETURN:
-    return simpleInstruction("OP_RETURN", offset);
-  case OP_CONSTANT:
-    return constantInstruction("OP_CONSTANT", chunk, offset);
-  case OP_NEGATE:
-    return simpleInstruction("OP_NEGATE", offset);
-  case OP_ADD:
-    return simpleInstruction("OP_ADD", offset);
-  case OP_SUB:
-    return simpleInstruction("OP_SUB", offset);
-  case OP_MULT:
-    return simpleInstruction("OP_MULT", offset);
-  case OP_DIV:
-    return simpleInstruction("OP_DIV", offset);
-  case OP_FALSE:
-    return simpleInstruction("OP_FALSE", offset);
-  case OP_TRUE:
-    return simpleInstruction("OP_TRUE", offset);
-  case OP_NIL:
-    return simpleInstruction("OP_NIL", offset);
-  case OP_EQUAL:
-    return simpleInstruction("OP_EQUAL", offset);
-  case OP_GREATER:
-    return simpleInstruction("OP_GREATER", offset);
-  case OP_LESS:
-    return simpleInstruction("OP_LESS", offset);
-  case OP_NOT:
-    return simpleInstruction("OP_NOT", offset);
-  case OP_PRINT:
-    return simpleInstruction("OP_PRINT", offset);
-  case OP_POP:
-    return simpleInstruction("OP_POP", offset);
-  case OP_POPN:
-    return byteInstruction("OP_POPN", chunk, offset);
-  case OP_DEFINE_GLOBAL:
-    return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
-  case OP_GET_GLOBAL:
-    return constantInstruction("OP_GET_GLOBAL", chunk, offset);
-  case OP_SET_GLOBAL:
-    return constantInstruction("OP_SET_GLOBAL", chunk, offset);
-  case OP_SET_LOCAL:
-    return byteInstruction("OP_SET_LOCAL", chunk, offset);
-  case OP_GET_LOCAL:
-    return byteInstruction("OP_GET_LOCAL", chunk, offset);
-  case OP_JUMPZ:
-    return jumpInstruction("OP_JUMPZ", chunk, offset);
-  case OP_JUMP:
-    return jumpInstruction("OP_JUMP", chunk, offset);
-  case OP_LOOP:
-    return jumpInstruction("OP_LOOP", chunk, offset);
-  case OP_CALL:
-    return byteInstruction("OP_CALL", chunk, offset);
-  case OP_CLOSURE: {
-    offset++;
-    uint8_t index = chunk->code[offset++];
-    printf("%-16s %4d ", "OP_CLOSURE", index);
-    printValue(chunk->constants.values[index]);
-    printf("\n");
-    ObjFunction* function = AS_FUNCTION(chunk->constants.values[index]);
-    for (int j = 0; j < function->upvalueCount; j++) {
-      int isLocal = chunk->code[offset++];
-      int index = chunk->code[offset++];
-      printf("%04d       |                       %s %d\n", offset - 2,
-             isLocal ? "local" : "upvalue", index);
-    }
-
-    return offset;
-  }
-  case OP_SET_UPVALUE:
-    return byteInstruction("OP_SET_UPVALUE", chunk, offset);
-  case OP_GET_UPVALUE:
-    return byteInstruction("OP_GET_UPVALUE", chunk, offset);
-  case OP_CLOSE_UPVALUE:
-    return simpleInstruction("OP_CLOSE_UPVALUE", offset);
-  default:
-    printf("Unknown opcode.. %d\n", chunk->code[offset]);
-    return offset + 1;
-  }
-}
+#include "debug.h"
+
+#include "object.h"
+#include "value.h"
+#include <stdio.h>
+
+void disassembleChunk(Chunk* chunk, const char* name) {
+  printf("== %s ==\n\n", name);
+  for (int offset = 0; offset < chunk->count;) {
+    offset = disassembleInstruction(chunk, offset);
+  }
+}
+
+static int simpleInstruction(const char* name, int offset) {
+  printf("%s\n", name);
+  return offset + 1;
+}
+
+static int constantInstruction(const char* name, Chunk* chunk, int offset) {
+  uint8_t index = chunk->code[offset + 1];
+  Value constant = chunk->constants.values[index];
+  printf("%-16s\t%4d '", name, index);
+  printValue(constant);
+  printf("'\n");
+  return offset + 2;
+}
+
+static int constantLongInstruction(const char* name, Chunk* chunk, int offset) {
+  uint16_t index =
+      (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+  Value constant = chunk->constants.values[index];
+  printf("%-16s\t%4d '", name, index);
+  printValue(constant);
+  printf("'\n");
+  return offset + 3;
+}
+
+static int byteInstruction(const char* name, Chunk* chunk, int offset) {
+  uint8_t slot = chunk->code[offset + 1];
+  printf("%-16s\t%4d\n", name, slot);
+  return offset + 2;
+}
+
+static int jumpInstruction(char* name, Chunk* chunk, int offset) {
+  uint8_t low = chunk->code[offset + 1];
+  uint8_t high = chunk->code[offset + 2];
+
+  uint16_t slot = (uint16_t)((low << 8) | (high & 0xff));
+  printf("%-16s\t%4d\n", name, slot);
+  return offset + 3;
+}
+
+int disassembleInstruction(Chunk* chunk, int offset) {
+  printf("%04d\t", offset);
+  if (offset > 0 && getLine(chunk, offset) == getLine(chunk, offset - 1))
+    printf("   | ");
+  else
+    printf("%4d ", getLine(chunk, offset));
+
+  uint8_t instruction = chunk->code[offset];
+  switch (instruction) {
+  case OP_RETURN:
+    return simpleInstruction("OP_RETURN", offset);
+  case OP_CONSTANT:
+    return constantInstruction("OP_CONSTANT", chunk, offset);
+  case OP_NEGATE:
+    return simpleInstruction("OP_NEGATE", offset);
+  case OP_ADD:
+    return simpleInstruction("OP_ADD", offset);
+  case OP_SUB:
+    return simpleInstruction("OP_SUB", offset);
+  case OP_MULT:
+    return simpleInstruction("OP_MULT", offset);
+  case OP_DIV:
+    return simpleInstruction("OP_DIV", offset);
+  case OP_FALSE:
+    return simpleInstruction("OP_FALSE", offset);
+  case OP_TRUE:
+    return simpleInstruction("OP_TRUE", offset);
+  case OP_NIL:
+    return simpleInstruction("OP_NIL", offset);
+  case OP_EQUAL:
+    return simpleInstruction("OP_EQUAL", offset);
+  case OP_GREATER:
+    return simpleInstruction("OP_GREATER", offset);
+  case OP_LESS:
+    return simpleInstruction("OP_LESS", offset);
+  case OP_NOT:
+    return simpleInstruction("OP_NOT", offset);
+  case OP_PRINT:
+    return simpleInstruction("OP_PRINT", offset);
+  case OP_POP:
+    return simpleInstruction("OP_POP", offset);
+  case OP_POPN:
+    return byteInstruction("OP_POPN", chunk, offset);
+  case OP_DEFINE_GLOBAL:
+    return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
+  case OP_GET_GLOBAL:
+    // +2 skips the inline cache operand.
+    return constantInstruction("OP_GET_GLOBAL", chunk, offset) + 2;
+  case OP_SET_GLOBAL:
+    return constantInstruction("OP_SET_GLOBAL", chunk, offset);
+  case OP_SET_LOCAL:
+    return byteInstruction("OP_SET_LOCAL", chunk, offset);
+  case OP_GET_LOCAL:
+    return byteInstruction("OP_GET_LOCAL", chunk, offset);
+  case OP_JUMPZ:
+    return jumpInstruction("OP_JUMPZ", chunk, offset);
+  case OP_JUMP:
+    return jumpInstruction("OP_JUMP", chunk, offset);
+  case OP_LOOP:
+    return jumpInstruction("OP_LOOP", chunk, offset);
+  case OP_CALL:
+    // +2 skips the inline cache operand.
+    return byteInstruction("OP_CALL", chunk, offset) + 2;
+  case OP_TAIL_CALL:
+    return byteInstruction("OP_TAIL_CALL", chunk, offset) + 2;
+  case OP_CLOSURE: {
+    offset++;
+    uint8_t index = chunk->code[offset++];
+    printf("%-16s %4d ", "OP_CLOSURE", index);
+    printValue(chunk->constants.values[index]);
+    printf("\n");
+    ObjFunction* function = AS_FUNCTION(chunk->constants.values[index]);
+    for (int j = 0; j < function->upvalueCount; j++) {
+      int isLocal = chunk->code[offset++];
+      int index = chunk->code[offset++];
+      printf("%04d       |                       %s %d\n", offset - 2,
+             isLocal ? "local" : "upvalue", index);
+    }
+
+    return offset;
+  }
+  case OP_SET_UPVALUE:
+    return byteInstruction("OP_SET_UPVALUE", chunk, offset);
+  case OP_GET_UPVALUE:
+    return byteInstruction("OP_GET_UPVALUE", chunk, offset);
+  case OP_CLOSE_UPVALUE:
+    return simpleInstruction("OP_CLOSE_UPVALUE", offset);
+  case OP_DEFINE_GLOBAL_SLOT:
+    return byteInstruction("OP_DEFINE_GLOBAL_SLOT", chunk, offset);
+  case OP_GET_GLOBAL_SLOT:
+    return byteInstruction("OP_GET_GLOBAL_SLOT", chunk, offset);
+  case OP_SET_GLOBAL_SLOT:
+    return byteInstruction("OP_SET_GLOBAL_SLOT", chunk, offset);
+  case OP_NOT_EQUAL:
+    return simpleInstruction("OP_NOT_EQUAL", offset);
+  case OP_GREATER_EQUAL:
+    return simpleInstruction("OP_GREATER_EQUAL", offset);
+  case OP_LESS_EQUAL:
+    return simpleInstruction("OP_LESS_EQUAL", offset);
+  case OP_ADD_CONST:
+    return constantInstruction("OP_ADD_CONST", chunk, offset);
+  case OP_ARRAY:
+    return byteInstruction("OP_ARRAY", chunk, offset);
+  case OP_INDEX_GET:
+    return simpleInstruction("OP_INDEX_GET", offset);
+  case OP_INDEX_SET:
+    return simpleInstruction("OP_INDEX_SET", offset);
+  case OP_CONSTANT_LONG:
+    return constantLongInstruction("OP_CONSTANT_LONG", chunk, offset);
+  case OP_DEFINE_GLOBAL_LONG:
+    return constantLongInstruction("OP_DEFINE_GLOBAL_LONG", chunk, offset);
+  case OP_GET_GLOBAL_LONG:
+    return constantLongInstruction("OP_GET_GLOBAL_LONG", chunk, offset);
+  case OP_SET_GLOBAL_LONG:
+    return constantLongInstruction("OP_SET_GLOBAL_LONG", chunk, offset);
+  // quickened forms only appear in chunks that have already run.
+  case OP_ADD_NUM:
+    return simpleInstruction("OP_ADD_NUM", offset);
+  case OP_ADD_STR:
+    return simpleInstruction("OP_ADD_STR", offset);
+  case OP_LESS_NUM:
+    return simpleInstruction("OP_LESS_NUM", offset);
+  case OP_GREATER_NUM:
+    return simpleInstruction("OP_GREATER_NUM", offset);
+  case OP_INLINE_GUARD: {
+    uint8_t argCount = chunk->code[offset + 1];
+    uint8_t constant = chunk->code[offset + 2];
+    uint16_t jump =
+        (uint16_t)((chunk->code[offset + 3] << 8) | chunk->code[offset + 4]);
+    printf("%-16s\t%4d '", "OP_INLINE_GUARD", argCount);
+    printValue(chunk->constants.values[constant]);
+    printf("' +%d\n", jump);
+    return offset + 5;
+  }
+  default:
+    printf("Unknown opcode.. %d\n", chunk->code[offset]);
+    return offset + 1;
+  }
+}
@@ -0,0 +1,319 @@
+#include "loxb.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chunk.h"
+#include "memory.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+#define LOXB_MAGIC 0x42584f4c // "LOXB", little-endian
+// version 2: run-length encoded line tables.
+// version 3: per-function maxStack.
+#define LOXB_VERSION 3
+
+// constant pool value tags
+typedef enum {
+  LXB_NIL,
+  LXB_TRUE,
+  LXB_FALSE,
+  LXB_NUMBER,
+  LXB_STRING,
+  LXB_FUNCTION
+} LoxbTag;
+
+// ------------------------------------------------------------------
+// writer
+// ------------------------------------------------------------------
+
+static void writeU8(FILE* out, uint8_t v) { fwrite(&v, sizeof v, 1, out); }
+
+static void writeU32(FILE* out, uint32_t v) { fwrite(&v, sizeof v, 1, out); }
+
+static void writeF64(FILE* out, double v) { fwrite(&v, sizeof v, 1, out); }
+
+static void writeString(FILE* out, ObjString* string) {
+  writeU32(out, (uint32_t)string->length);
+  fwrite(string->chars, sizeof(char), string->length, out);
+}
+
+static void writeFunction(FILE* out, ObjFunction* function);
+
+static void writeValue(FILE* out, Value value) {
+  if (IS_NIL(value)) {
+    writeU8(out, LXB_NIL);
+  } else if (IS_BOOL(value)) {
+    writeU8(out, AS_BOOL(value) ? LXB_TRUE : LXB_FALSE);
+  } else if (IS_NUMBER(value)) {
+    writeU8(out, LXB_NUMBER);
+    writeF64(out, AS_NUMBER(value));
+  } else if (IS_STRING(value)) {
+    writeU8(out, LXB_STRING);
+    writeString(out, AS_STRING(value));
+  } else if (IS_FUNCTION(value)) {
+    writeU8(out, LXB_FUNCTION);
+    writeFunction(out, AS_FUNCTION(value));
+  }
+  // nothing else can appear in a constant pool.
+}
+
+static void writeFunction(FILE* out, ObjFunction* function) {
+  writeU32(out, (uint32_t)function->arity);
+  writeU32(out, (uint32_t)function->upvalueCount);
+  writeU32(out, (uint32_t)function->maxStack);
+
+  if (function->name == NULL) {
+    writeU32(out, 0);
+  } else {
+    writeU32(out, 1);
+    writeString(out, function->name);
+  }
+
+  Chunk* chunk = &function->chunk;
+  writeU32(out, (uint32_t)chunk->count);
+  fwrite(chunk->code, sizeof(uint8_t), chunk->count, out);
+  writeU32(out, (uint32_t)chunk->lineCount);
+  fwrite(chunk->lines, sizeof(LineStart), chunk->lineCount, out);
+  // caches are derived data: only the count is needed to rebuild them.
+  writeU32(out, (uint32_t)chunk->cacheCount);
+
+  writeU32(out, (uint32_t)chunk->constants.count);
+  for (int i = 0; i < chunk->constants.count; i++) {
+    writeValue(out, chunk->constants.values[i]);
+  }
+}
+
+// records the compiler's name -> slot assignments (in slot order) so
+// the loader can check the layout against its own VM.
+static void writeGlobalLayout(FILE* out) {
+  int count = vm.globalSlots.count;
+  ObjString** names = ALLOCATE(ObjString*, count);
+  for (int i = 0; i < count; i++)
+    names[i] = NULL;
+
+  for (int i = 0; i < vm.globalNames.cap; i++) {
+    Entry* entry = &vm.globalNames.entries[i];
+    if (entry->key != NULL) {
+      names[(int)AS_NUMBER(entry->value)] = entry->key;
+    }
+  }
+
+  writeU32(out, (uint32_t)count);
+  for (int i = 0; i < count; i++) {
+    writeString(out, names[i]);
+  }
+  FREE_ARRAY(names, ObjString*, count);
+}
+
+bool writeLoxb(ObjFunction* function, const char* path) {
+  FILE* out = fopen(path, "wb");
+  if (out == NULL)
+    return false;
+
+  writeU32(out, LOXB_MAGIC);
+  writeU32(out, LOXB_VERSION);
+  writeGlobalLayout(out);
+  writeFunction(out, function);
+
+  bool ok = ferror(out) == 0;
+  fclose(out);
+  return ok;
+}
+
+// ------------------------------------------------------------------
+// reader
+// ------------------------------------------------------------------
+
+// cursor over the memory-mapped file. Every read bounds-checks and
+// trips 'ok' instead of running off the mapping.
+typedef struct {
+  const uint8_t* at;
+  const uint8_t* end;
+  bool ok;
+} Reader;
+
+static const uint8_t* readBytes(Reader* reader, size_t count) {
+  if (!reader->ok || (size_t)(reader->end - reader->at) < count) {
+    reader->ok = false;
+    return NULL;
+  }
+  const uint8_t* bytes = reader->at;
+  reader->at += count;
+  return bytes;
+}
+
+static uint8_t readU8(Reader* reader) {
+  const uint8_t* bytes = readBytes(reader, sizeof(uint8_t));
+  return bytes == NULL ? 0 : *bytes;
+}
+
+static uint32_t readU32(Reader* reader) {
+  uint32_t v = 0;
+  const uint8_t* bytes = readBytes(reader, sizeof v);
+  if (bytes != NULL)
+    memcpy(&v, bytes, sizeof v);
+  return v;
+}
+
+static double readF64(Reader* reader) {
+  double v = 0;
+  const uint8_t* bytes = readBytes(reader, sizeof v);
+  if (bytes != NULL)
+    memcpy(&v, bytes, sizeof v);
+  return v;
+}
+
+static ObjString* readString(Reader* reader) {
+  uint32_t length = readU32(reader);
+  const uint8_t* chars = readBytes(reader, length);
+  if (chars == NULL)
+    return NULL;
+  // interned like any other string, so pointer equality keeps working.
+  return copyString((const char*)chars, (int)length);
+}
+
+static ObjFunction* readFunction(Reader* reader);
+
+static Value readValue(Reader* reader) {
+  switch (readU8(reader)) {
+  case LXB_NIL:
+    return NIL_VAL;
+  case LXB_TRUE:
+    return BOOL_VAL(true);
+  case LXB_FALSE:
+    return BOOL_VAL(false);
+  case LXB_NUMBER:
+    return NUMBER_VAL(readF64(reader));
+  case LXB_STRING: {
+    ObjString* string = readString(reader);
+    if (string == NULL)
+      return NIL_VAL;
+    return OBJ_VAL(string);
+  }
+  case LXB_FUNCTION: {
+    ObjFunction* function = readFunction(reader);
+    if (function == NULL)
+      return NIL_VAL;
+    return OBJ_VAL(function);
+  }
+  default:
+    reader->ok = false;
+    return NIL_VAL;
+  }
+}
+
+static ObjFunction* readFunction(Reader* reader) {
+  ObjFunction* function = newFunction();
+  // deserializing constants allocates; keep the half-built function
+  // rooted on the VM stack so a collection can't sweep it.
+  pushValue(&vm.stack, OBJ_VAL(function));
+
+  function->arity = (int)readU32(reader);
+  function->upvalueCount = (int)readU32(reader);
+  function->maxStack = (int)readU32(reader);
+
+  if (readU32(reader) != 0) {
+    function->name = readString(reader);
+    // reading can collect and promote the half-built function; young
+    // values stored into it afterwards need the write barrier.
+    gcWriteBarrier((Obj*)function, OBJ_VAL(function->name));
+  }
+
+  Chunk* chunk = &function->chunk;
+  uint32_t count = readU32(reader);
+  const uint8_t* code = readBytes(reader, count);
+  uint32_t lineCount = readU32(reader);
+  const uint8_t* lines = readBytes(reader, lineCount * sizeof(LineStart));
+  if (code != NULL && lines != NULL) {
+    chunk->code = GROW_ARRAY(chunk->code, uint8_t, 0, count);
+    chunk->lines = GROW_ARRAY(chunk->lines, LineStart, 0, lineCount);
+    chunk->capacity = count;
+    chunk->count = count;
+    chunk->lineCapacity = lineCount;
+    chunk->lineCount = lineCount;
+    memcpy(chunk->code, code, count);
+    memcpy(chunk->lines, lines, lineCount * sizeof(LineStart));
+  }
+
+  uint32_t cacheCount = readU32(reader);
+  for (uint32_t i = 0; i < cacheCount && reader->ok; i++) {
+    addInlineCache(chunk);
+  }
+
+  uint32_t constantCount = readU32(reader);
+  for (uint32_t i = 0; i < constantCount && reader->ok; i++) {
+    Value constant = readValue(reader);
+    addConstant(chunk, constant);
+    gcWriteBarrier((Obj*)function, constant);
+  }
+
+  popValue(&vm.stack);
+  return reader->ok ? function : NULL;
+}
+
+// replays the recorded name -> slot assignments against this VM. With
+// the standard natives installed the numbering always matches; a
+// mismatch means the file was produced by an incompatible build.
+static bool readGlobalLayout(Reader* reader) {
+  uint32_t count = readU32(reader);
+  for (uint32_t i = 0; i < count; i++) {
+    ObjString* name = readString(reader);
+    if (name == NULL)
+      return false;
+    if (globalSlot(name) != (int)i) {
+      fprintf(stderr, "loxb: global slot layout mismatch for '%s'.\n",
+              name->chars);
+      return false;
+    }
+  }
+  return reader->ok;
+}
+
+ObjFunction* readLoxb(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    fprintf(stderr, "Could not open file '%s'\n", path);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Could not map file '%s'\n", path);
+    return NULL;
+  }
+
+  Reader reader;
+  reader.at = (const uint8_t*)mapping;
+  reader.end = reader.at + st.st_size;
+  reader.ok = true;
+
+  ObjFunction* function = NULL;
+  if (readU32(&reader) == LOXB_MAGIC && readU32(&reader) == LOXB_VERSION &&
+      readGlobalLayout(&reader)) {
+    function = readFunction(&reader);
+  } else if (reader.ok) {
+    fprintf(stderr, "loxb: '%s' is not a compatible bytecode file.\n", path);
+  }
+
+  if (!reader.ok) {
+    fprintf(stderr, "loxb: '%s' is truncated or corrupt.\n", path);
+    function = NULL;
+  }
+
+  munmap(mapping, st.st_size);
+  return function;
+}
@@ -0,0 +1,32 @@
+#ifndef clox_loxb_h
+#define clox_loxb_h
+
+#include "object.h"
+
+/*
+    LOXB:
+    Ahead-of-time compiled bytecode, so hot scripts can skip the
+    scanner and compiler entirely at startup.
+
+    A .loxb file is a small header (magic + version) followed by the
+    script's ObjFunction serialized recursively: arity, upvalue count,
+    name, code, line info, inline cache count and the constant pool
+    (numbers, strings and nested functions). The file also records the
+    global slot layout the compiler assigned (user-004) so the loader
+    can verify it matches the VM it is loaded into.
+
+    The format is native-endian and makes no attempt at cross-machine
+    portability; it's a cache, not an interchange format. Loading
+    memory-maps the file and parses straight out of the mapping.
+*/
+
+// compiles nothing itself: serializes an already-compiled script
+// function to 'path'. Returns false on I/O failure.
+bool writeLoxb(ObjFunction* function, const char* path);
+
+// maps and deserializes a .loxb file. Returns NULL if the file can't
+// be read, is malformed, or was compiled against an incompatible
+// global slot layout.
+ObjFunction* readLoxb(const char* path);
+
+#endif
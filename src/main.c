@@ -1,92 +1,221 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "chunk.h"
-#include "compiler.h"
-#include "debug.h"
-#include "vm.h"
-
-void chunkTest() {
-  printf("\n<Chunk tests>\n");
-  Chunk chnk;
-  initChunk(&chnk);
-  writeChunk(&chnk, OP_RETURN, 1);
-  int constIndex = addConstant(&chnk, NUMBER_VAL(12.3));
-  writeChunk(&chnk, OP_CONSTANT, 1);
-  writeChunk(&chnk, constIndex, 1);
-  writeChunk(&chnk, OP_NEGATE, 1);
-  disassembleChunk(&chnk, "test chunk");
-  freeChunk(&chnk);
-  printf("\n</Chunk tests>\n");
-}
-
-void vmTest() {
-  printf("\n<VM tests>\n");
-  initVM();
-  interpret("var a = \"aaa\"; print a + a + a;");
-  freeVM();
-  printf("\n</VM tests>\n");
-}
-
-static void repl() {
-  // char line[1024];
-  while (true) {
-    break;
-  }
-}
-
-static char* readFile(const char* filePath) {
-  FILE* file;
-  fopen_s(&file, filePath, "r");
-
-  if (!file) {
-    fprintf(stderr, "Could not open file \'%s\'\n", filePath);
-    exit(EXIT_FAILURE);
-  }
-
-  fseek(file, 0, SEEK_END);
-  size_t fileSize = ftell(file);
-  rewind(file);
-  char* buffer = (char*)malloc(fileSize + 1);
-  size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-
-  if (buffer == NULL) {
-    fprintf(stderr, "Not enough memory to read \'%s\'.\n", filePath);
-    exit(EXIT_FAILURE);
-  }
-
-  if (bytesRead < fileSize) {
-    fprintf(stderr, "Couldn't read file \'%s\'.\n", filePath);
-  }
-
-  buffer[bytesRead] = '\0';
-  return buffer;
-}
-
-static void runFile(const char* filePath) {
-  char* sourceCode = readFile(filePath);
-  printf("running lox interpreter on file: '%s'\n", filePath);
-  interpret(sourceCode);
-}
-
-static void runLox(int argc, char const* argv[]) {
-  initVM();
-  printf("cLox | Crafting Interpreters (Bob Nystrom).\n");
-
-  if (argc == 1) {
-    repl();
-  } else if (argc == 2) {
-    runFile(argv[1]);
-  } else {
-    fprintf(stderr, "Usage: clox [path].\n");
-  }
-
-  freeVM();
-}
-
-int main(int argc, char const* argv[]) {
-  runLox(argc, argv);
-  // vmTest();
-  return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "chunk.h"
+#include "compiler.h"
+#include "debug.h"
+#include "loxb.h"
+#include "profiler.h"
+#include "scanner.h"
+#include "vm.h"
+
+void chunkTest() {
+  printf("\n<Chunk tests>\n");
+  Chunk chnk;
+  initChunk(&chnk);
+  writeChunk(&chnk, OP_RETURN, 1);
+  int constIndex = addConstant(&chnk, NUMBER_VAL(12.3));
+  writeChunk(&chnk, OP_CONSTANT, 1);
+  writeChunk(&chnk, constIndex, 1);
+  writeChunk(&chnk, OP_NEGATE, 1);
+  disassembleChunk(&chnk, "test chunk");
+  freeChunk(&chnk);
+  printf("\n</Chunk tests>\n");
+}
+
+void vmTest() {
+  printf("\n<VM tests>\n");
+  initVM();
+  interpret("var a = \"aaa\"; print a + a + a;");
+  freeVM();
+  printf("\n</VM tests>\n");
+}
+
+// one VM for the whole session: globals, interned strings, and the
+// fragment cache in vm.replCache all survive from line to line, so an
+// unchanged input re-runs its cached bytecode without recompiling.
+static void repl() {
+  char line[1024 + SCANNER_PADDING];
+  for (;;) {
+    printf("> ");
+    if (!fgets(line, sizeof(line), stdin)) {
+      printf("\n");
+      break;
+    }
+    interpretLine(line);
+  }
+}
+
+static char* readFile(const char* filePath) {
+  FILE* file = fopen(filePath, "r");
+
+  if (!file) {
+    fprintf(stderr, "Could not open file \'%s\'\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+
+  fseek(file, 0, SEEK_END);
+  size_t fileSize = ftell(file);
+  rewind(file);
+  // the scanner reads in aligned 16-byte blocks, so the buffer needs
+  // SCANNER_PADDING readable bytes after the terminator.
+  char* buffer = (char*)malloc(fileSize + 1 + SCANNER_PADDING);
+
+  if (buffer == NULL) {
+    fprintf(stderr, "Not enough memory to read \'%s\'.\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+
+  size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+  if (bytesRead < fileSize) {
+    fprintf(stderr, "Couldn't read file \'%s\'.\n", filePath);
+  }
+
+  memset(buffer + bytesRead, 0, 1 + SCANNER_PADDING);
+  return buffer;
+}
+
+// a loaded script: either a read-only mapping of the file's pages or,
+// when mapping isn't possible, the heap copy readFile makes.
+typedef struct {
+  const char* source;
+  void* mapping;
+  size_t mappedSize;
+} SourceFile;
+
+// loads a script without copying it where possible: the file is mapped
+// read-only and the scanner walks the pages directly. POSIX zero-fills
+// the tail of the last partial page, so the byte after the source is
+// the NUL terminator the scanner expects; files whose size is an exact
+// page multiple (no spare byte) and platforms without mmap fall back
+// to readFile. The mapping must stay alive until compilation is done -
+// tokens point straight into it.
+static SourceFile openSource(const char* filePath) {
+  SourceFile file = {NULL, NULL, 0};
+#if defined(__unix__) || defined(__APPLE__)
+  int fd = open(filePath, O_RDONLY);
+  if (fd != -1) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+        st.st_size % sysconf(_SC_PAGESIZE) != 0) {
+      void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        file.source = (const char*)mapping;
+        file.mapping = mapping;
+        file.mappedSize = (size_t)st.st_size;
+      }
+    }
+    close(fd);
+  }
+#endif
+  if (file.source == NULL)
+    file.source = readFile(filePath);
+  return file;
+}
+
+static void closeSource(SourceFile* file) {
+#if defined(__unix__) || defined(__APPLE__)
+  if (file->mapping != NULL) {
+    munmap(file->mapping, file->mappedSize);
+    file->mapping = NULL;
+    file->source = NULL;
+    return;
+  }
+#endif
+  free((char*)file->source);
+  file->source = NULL;
+}
+
+static bool hasExtension(const char* filePath, const char* extension) {
+  size_t pathLen = strlen(filePath);
+  size_t extLen = strlen(extension);
+  return pathLen >= extLen &&
+         strcmp(filePath + pathLen - extLen, extension) == 0;
+}
+
+static void runFile(const char* filePath) {
+  if (hasExtension(filePath, ".loxb")) {
+    // ahead-of-time compiled bytecode: skip the compiler entirely.
+    ObjFunction* function = readLoxb(filePath);
+    if (function == NULL)
+      exit(EXIT_FAILURE);
+    printf("running lox interpreter on bytecode file: '%s'\n", filePath);
+    interpretCompiled(function);
+    return;
+  }
+
+  SourceFile sourceFile = openSource(filePath);
+  printf("running lox interpreter on file: '%s'\n", filePath);
+  interpret(sourceFile.source);
+  closeSource(&sourceFile);
+}
+
+// compiles a script to <script>.loxb next to it without running it.
+static void compileFile(const char* filePath) {
+  SourceFile sourceFile = openSource(filePath);
+  ObjFunction* function = compile(sourceFile.source);
+  closeSource(&sourceFile);
+  if (function == NULL)
+    exit(EXIT_FAILURE);
+
+  size_t pathLen = strlen(filePath);
+  char* outPath = (char*)malloc(pathLen + 6);
+  strcpy(outPath, filePath);
+  if (hasExtension(filePath, ".lox")) {
+    strcpy(outPath + pathLen - 4, ".loxb");
+  } else {
+    strcpy(outPath + pathLen, ".loxb");
+  }
+
+  if (!writeLoxb(function, outPath)) {
+    fprintf(stderr, "Could not write bytecode to '%s'.\n", outPath);
+    exit(EXIT_FAILURE);
+  }
+  printf("compiled '%s' to '%s'\n", filePath, outPath);
+  free(outPath);
+}
+
+static void runLox(int argc, char const* argv[]) {
+  initVM();
+  if (sampleEnabled)
+    sampleStart();
+  printf("cLox | Crafting Interpreters (Bob Nystrom).\n");
+
+  if (argc == 1) {
+    repl();
+  } else if (argc == 2) {
+    runFile(argv[1]);
+  } else if (argc == 3 && strcmp(argv[1], "-c") == 0) {
+    compileFile(argv[2]);
+  } else {
+    fprintf(stderr, "Usage: clox [--profile] [--sample] [-c] [path].\n");
+  }
+
+  freeVM();
+}
+
+int main(int argc, char const* argv[]) {
+  while (argc > 1) {
+    if (strcmp(argv[1], "--profile") == 0) {
+      profileEnabled = true;
+    } else if (strcmp(argv[1], "--sample") == 0) {
+      sampleEnabled = true;
+    } else {
+      break;
+    }
+    argv++;
+    argc--;
+  }
+
+  runLox(argc, argv);
+  // vmTest();
+  return 0;
+}
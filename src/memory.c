@@ -1,174 +1,527 @@
-#include "memory.h"
-#include "common.h"
-#include <stdlib.h>
-
-#include "object.h"
-#include "vm.h"
-
-#ifdef DEBUG_LOG_GC
-#include "debug.h"
-#include <stdio.h>
-#endif
-
-void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
-  if (newSize > oldSize) {
-#ifdef DEBUG_STRESS_GC
-    collectGarbage();
-#endif
-  }
-
-  if (newSize == 0) {
-    free(pointer);
-    return NULL;
-  }
-  return realloc(pointer, newSize);
-}
-
-static void freeObject(Obj* object) {
-#ifdef DEBUG_LOG_GC
-  printf("%p free type %d\n", (void*)object, object->type);
-#endif
-
-  switch (object->type) {
-  case OBJ_STRING: {
-    ObjString* string = (ObjString*)object;
-    FREE(ObjString, string);
-    break;
-  }
-
-  case OBJ_FUNCTION: {
-    ObjFunction* func = (ObjFunction*)object;
-    freeChunk(&func->chunk);
-    FREE(ObjFunction, object);
-    break;
-  }
-
-  case OBJ_NATIVE:
-    FREE(ObjNative, object);
-    break;
-
-  case OBJ_CLOSURE:
-    ObjClosure* closure = (ObjClosure*)object;
-    FREE_ARRAY(closure->upvalues, ObjUpvalue*, closure->upvalueCount);
-    FREE(ObjClosure, object);
-    break;
-
-  case OBJ_UPVALUE:
-    FREE(ObjUpvalue, object);
-    break;
-  default:
-    break;
-  }
-}
-
-void freeObjects() {
-  Obj* object = vm.objects;
-  while (object != NULL) {
-    Obj* next = object->next;
-    freeObject(object);
-    object = next;
-  }
-}
-
-static void markArray();
-
-static void blackenObject(Obj* object) {
-#ifdef DEBUG_LOG_GC
-  printf("%p blacken ", (void*)object);
-  printValue(OBJ_VAL(object));
-  printf("\n");
-#endif
-
-  switch (object->type) {
-  case OBJ_NATIVE:
-  case OBJ_STRING:
-    break;
-  case OBJ_UPVALUE:
-    markValue(((ObjUpvalue*)object)->closed);
-    break;
-  case OBJ_FUNCTION: {
-    ObjFunction* func = (ObjFunction*)object;
-    markObject((Obj*)func->name);
-    markArray(&(func->chunk.constants));
-    break;
-  }
-  case OBJ_CLOSURE: {
-    ObjClosure* closure = (ObjClosure*)object;
-    markObject((Obj*)closure->function);
-    for (int i = 0; i < closure->upvalueCount; i++) {
-      markObject((Obj*)closure->upvalues[i]);
-    }
-    break;
-  }
-  default:
-    break;
-  }
-}
-
-static void markRoots() {
-  for (Value* slot = vm.stack.values; slot < vm.stack.top; slot++) {
-    markValue(*slot);
-  }
-
-  for (int i = 0; i < vm.frameCount; i++) {
-    markObject((Obj*)vm.frames[i].closure);
-  }
-
-  for (ObjUpvalue* upval = vm.openUpvalues; upval != NULL;
-       upval = upval->next) {
-    markObject((Obj*)upval);
-  }
-}
-
-static void traceRefs() {
-  while (vm.grayCount > 0) {
-    Obj* object = vm.grayStack[--vm.grayCount];
-    blackenObject(object);
-  }
-}
-
-static void markArray(ValueArray* array) {
-  for (int i = 0; i < array->count; i++) {
-    markValue(array->values[i]);
-  }
-}
-
-void collectGarbage() {
-#ifdef DEBUG_LOG_GC
-  printf("-- gc begin\n");
-#endif
-
-  markRoots();
-  traceRefs();
-
-#ifdef DEBUG_LOG_GC
-  printf("\n-- gc end\n");
-#endif
-}
-
-void markValue(Value val) {
-  if (!IS_OBJ(val))
-    return;
-  markObject(AS_OBJ(val));
-}
-
-void markObject(Obj* object) {
-  if (object == NULL)
-    return;
-  if (object->isMarked)
-    return;
-#ifdef DEBUG_LOG_GC
-  printf("%p mark ", (void*)object);
-  printValue(OBJ_VAL(object));
-  printf("\n");
-#endif
-  object->isMarked = true;
-
-  if (vm.grayCapacity < vm.grayCount + 1) {
-    vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
-    vm.grayStack = realloc(vm.grayStack, sizeof(Obj*) * vm.grayCapacity);
-    if (vm.grayStack == NULL)
-      exit(1);
-  }
-  vm.grayStack[vm.grayCount++] = object;
+#include "memory.h"
+#include "common.h"
+#include <stdlib.h>
+#include <time.h>
+
+#include "compiler.h"
+#include "object.h"
+#include "profiler.h"
+#include "vm.h"
+
+#ifdef DEBUG_LOG_GC
+#include "debug.h"
+#include <stdio.h>
+#endif
+
+// every collection leaves the heap with room to grow by this
+// factor before the next one kicks in. Larger values trade memory
+// for fewer (and therefore cheaper per-byte) collections.
+#ifndef GC_HEAP_GROW_FACTOR
+#define GC_HEAP_GROW_FACTOR 2
+#endif
+
+// allocation since the last collection that triggers a minor one.
+// Minor pauses scale with this, not with the live heap, so the
+// short-lived garbage that dominates allocation (concatenation ropes,
+// upvalues, per-iteration closures) gets reclaimed without ever
+// tracing the old generation.
+#ifndef GC_NURSERY_SIZE
+#define GC_NURSERY_SIZE (256 * 1024)
+#endif
+
+// under DEBUG_STRESS_GC every allocation runs a minor collection - the
+// harshest exercise for the write barriers - while major collections
+// keep their normal pacing.
+static void maybeCollect() {
+#ifdef DEBUG_STRESS_GC
+  collectGarbageMinor();
+#endif
+  if (vm.bytesAllocated > vm.nextGC) {
+    collectGarbage();
+  } else if (vm.youngBytes > GC_NURSERY_SIZE) {
+    collectGarbageMinor();
+  }
+}
+
+void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+  vm.bytesAllocated += newSize - oldSize;
+
+  if (newSize > oldSize) {
+    vm.youngBytes += newSize - oldSize;
+    maybeCollect();
+  }
+
+  if (newSize == 0) {
+    free(pointer);
+    return NULL;
+  }
+  return realloc(pointer, newSize);
+}
+
+/*
+  Object pool: Lox objects are small (a closure is ~40 bytes, an
+  upvalue ~48) and churn fast, so going through malloc for each one is
+  needless overhead and scatters them across the heap. Allocations up
+  to POOL_MAX_SIZE are carved out of slabs in POOL_ALIGN-sized classes
+  instead; freed blocks go on a per-class free list and are handed out
+  again in LIFO order, which also keeps recently-touched memory hot.
+  Anything larger (big strings, mostly) falls through to reallocate.
+*/
+
+#define POOL_ALIGN 16
+#define POOL_MAX_SIZE 256
+#define POOL_CLASSES (POOL_MAX_SIZE / POOL_ALIGN)
+#define POOL_SLAB_SIZE (16 * 1024)
+
+typedef struct FreeBlock {
+  struct FreeBlock* next;
+} FreeBlock;
+
+typedef struct Slab {
+  struct Slab* next;
+  // pad the header so the first block keeps POOL_ALIGN alignment.
+  char pad[POOL_ALIGN - sizeof(struct Slab*)];
+} Slab;
+
+// per-thread: pooled objects belong to the owning thread's isolate and
+// must be freed back to the pool they came from.
+static _Thread_local FreeBlock* freeLists[POOL_CLASSES];
+static _Thread_local Slab* slabs = NULL;
+static _Thread_local char* slabCursor = NULL;
+static _Thread_local size_t slabRemaining = 0;
+
+void* poolAllocate(size_t size) {
+  if (size > POOL_MAX_SIZE)
+    return reallocate(NULL, 0, size);
+
+  // pooled blocks bypass reallocate, so do its bookkeeping here:
+  // the GC paces itself on per-object bytes, not slab bytes.
+  vm.bytesAllocated += size;
+  vm.youngBytes += size;
+  maybeCollect();
+
+  int sizeClass = (int)((size + POOL_ALIGN - 1) / POOL_ALIGN) - 1;
+  size_t blockSize = (size_t)(sizeClass + 1) * POOL_ALIGN;
+
+  FreeBlock* block = freeLists[sizeClass];
+  if (block != NULL) {
+    freeLists[sizeClass] = block->next;
+    return block;
+  }
+
+  if (slabRemaining < blockSize) {
+    Slab* slab = malloc(POOL_SLAB_SIZE);
+    if (slab == NULL)
+      exit(1);
+    slab->next = slabs;
+    slabs = slab;
+    slabCursor = (char*)slab + sizeof(Slab);
+    slabRemaining = POOL_SLAB_SIZE - sizeof(Slab);
+  }
+
+  void* pointer = slabCursor;
+  slabCursor += blockSize;
+  slabRemaining -= blockSize;
+  return pointer;
+}
+
+void poolFree(void* pointer, size_t size) {
+  if (size > POOL_MAX_SIZE) {
+    reallocate(pointer, size, 0);
+    return;
+  }
+
+  vm.bytesAllocated -= size;
+  int sizeClass = (int)((size + POOL_ALIGN - 1) / POOL_ALIGN) - 1;
+  FreeBlock* block = (FreeBlock*)pointer;
+  block->next = freeLists[sizeClass];
+  freeLists[sizeClass] = block;
+}
+
+// releases the slabs themselves; only valid once every pooled object
+// has been freed (i.e. at VM shutdown, after freeObjects).
+void freePools() {
+  Slab* slab = slabs;
+  while (slab != NULL) {
+    Slab* next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  slabs = NULL;
+  slabCursor = NULL;
+  slabRemaining = 0;
+  for (int i = 0; i < POOL_CLASSES; i++) {
+    freeLists[i] = NULL;
+  }
+}
+
+static void freeObject(Obj* object) {
+#ifdef DEBUG_LOG_GC
+  printf("%p free type %d\n", (void*)object, object->type);
+#endif
+
+  switch (object->type) {
+  case OBJ_STRING: {
+    ObjString* string = (ObjString*)object;
+    // the characters live in-place after the struct, so the real
+    // allocation size depends on the string's length.
+    poolFree(string, sizeof(ObjString) + string->length + 1);
+    break;
+  }
+
+  case OBJ_FUNCTION: {
+    ObjFunction* func = (ObjFunction*)object;
+    freeChunk(&func->chunk);
+    poolFree(object, sizeof(ObjFunction));
+    break;
+  }
+
+  case OBJ_NATIVE:
+    poolFree(object, sizeof(ObjNative));
+    break;
+
+  case OBJ_CLOSURE:
+    ObjClosure* closure = (ObjClosure*)object;
+    FREE_ARRAY(closure->upvalues, ObjUpvalue*, closure->upvalueCount);
+    poolFree(object, sizeof(ObjClosure));
+    break;
+
+  case OBJ_UPVALUE:
+    poolFree(object, sizeof(ObjUpvalue));
+    break;
+
+  case OBJ_ROPE:
+    // children are separate objects with their own list entries.
+    poolFree(object, sizeof(ObjRope));
+    break;
+
+  case OBJ_ARRAY:
+    freeValueArray(&((ObjArray*)object)->elements);
+    poolFree(object, sizeof(ObjArray));
+    break;
+
+  case OBJ_FIBER: {
+    ObjFiber* fiber = (ObjFiber*)object;
+    // a running fiber's buffers live in the VM and are torn down with
+    // it; a suspended one still owns its own.
+    if (fiber->stack.values != NULL)
+      freeValueStack(&fiber->stack);
+    if (fiber->frames != NULL)
+      FREE_ARRAY(fiber->frames, CallFrame, FRAMES_MAX);
+    poolFree(object, sizeof(ObjFiber));
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void freeObjects() {
+  Obj* object = vm.objects;
+  while (object != NULL) {
+    Obj* next = object->next;
+    freeObject(object);
+    object = next;
+  }
+  object = vm.youngObjects;
+  while (object != NULL) {
+    Obj* next = object->next;
+    freeObject(object);
+    object = next;
+  }
+}
+
+void gcRemember(Obj* container) {
+  if (container == NULL || !container->isOld || container->isRemembered)
+    return;
+  container->isRemembered = true;
+
+  if (vm.rememberedCapacity < vm.rememberedCount + 1) {
+    vm.rememberedCapacity = GROW_CAPACITY(vm.rememberedCapacity);
+    vm.remembered =
+        realloc(vm.remembered, sizeof(Obj*) * vm.rememberedCapacity);
+    if (vm.remembered == NULL)
+      exit(1);
+  }
+  vm.remembered[vm.rememberedCount++] = container;
+}
+
+void gcWriteBarrier(Obj* container, Value value) {
+  // only an old object pointing at a young one breaks the invariant a
+  // minor collection relies on; everything else is filtered out here,
+  // which keeps the barrier to a couple of loads on the hot paths.
+  if (!IS_OBJ(value) || AS_OBJ(value)->isOld)
+    return;
+  gcRemember(container);
+}
+
+static void markArray(ValueArray* array);
+
+static void blackenObject(Obj* object) {
+#ifdef DEBUG_LOG_GC
+  printf("%p blacken ", (void*)object);
+  printValue(OBJ_VAL(object));
+  printf("\n");
+#endif
+
+  switch (object->type) {
+  case OBJ_NATIVE:
+  case OBJ_STRING:
+    break;
+  case OBJ_UPVALUE:
+    markValue(((ObjUpvalue*)object)->closed);
+    break;
+  case OBJ_ROPE: {
+    ObjRope* rope = (ObjRope*)object;
+    markObject(rope->left);
+    markObject(rope->right);
+    markObject((Obj*)rope->flat);
+    break;
+  }
+  case OBJ_ARRAY:
+    markArray(&((ObjArray*)object)->elements);
+    break;
+  case OBJ_FIBER: {
+    ObjFiber* fiber = (ObjFiber*)object;
+    markObject((Obj*)fiber->closure);
+    markObject((Obj*)fiber->function);
+    markObject((Obj*)fiber->caller);
+    // a running fiber's execution state is traced through the VM
+    // roots; a parked one is traced here (same walk as markRoots).
+    for (Value* slot = fiber->stack.values; slot < fiber->stack.top; slot++) {
+      markValue(*slot);
+    }
+    for (int i = 0; i < fiber->frameCount; i++) {
+      markObject((Obj*)fiber->frames[i].closure);
+      markObject((Obj*)fiber->frames[i].function);
+    }
+    for (ObjUpvalue* upval = fiber->openUpvalues; upval != NULL;
+         upval = upval->next) {
+      markObject((Obj*)upval);
+    }
+    break;
+  }
+  case OBJ_FUNCTION: {
+    ObjFunction* func = (ObjFunction*)object;
+    markObject((Obj*)func->name);
+    markArray(&(func->chunk.constants));
+    // cached callees are raw pointers the sweep doesn't know about;
+    // keep them alive for as long as the caller is.
+    for (int i = 0; i < func->chunk.cacheCount; i++) {
+      markObject(func->chunk.caches[i].callee);
+    }
+    break;
+  }
+  case OBJ_CLOSURE: {
+    ObjClosure* closure = (ObjClosure*)object;
+    markObject((Obj*)closure->function);
+    for (int i = 0; i < closure->upvalueCount; i++) {
+      markObject((Obj*)closure->upvalues[i]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void markRoots() {
+  for (Value* slot = vm.stack.values; slot < vm.stack.top; slot++) {
+    markValue(*slot);
+  }
+
+  for (int i = 0; i < vm.frameCount; i++) {
+    markObject((Obj*)vm.frames[i].closure);
+    markObject((Obj*)vm.frames[i].function);
+  }
+
+  for (ObjUpvalue* upval = vm.openUpvalues; upval != NULL;
+       upval = upval->next) {
+    markObject((Obj*)upval);
+  }
+
+  // suspended fibers hang off the current one through caller links (or
+  // off script variables, which the stack walk above covers).
+  markObject((Obj*)vm.fiber);
+
+  markTable(&vm.globals);
+  markTable(&vm.globalNames);
+  markArray(&vm.globalSlots);
+  markTable(&vm.replCache);
+  // vm.strings is deliberately NOT marked: interning is a weak table,
+  // cleaned of dying keys by tableRemoveWhite before the sweep, so
+  // transient strings aren't immortal.
+  // functions still being compiled aren't reachable from the VM yet.
+  markCompilerRoots();
+  // the sampler's captured stacks keep their functions alive until the
+  // dump can symbolize them.
+  sampleMarkRoots();
+}
+
+// walks the VM's object list after the trace: unmarked objects are
+// garbage and get freed, marked ones survive and have their mark
+// cleared for the next cycle.
+static void sweep() {
+  Obj* previous = NULL;
+  Obj* object = vm.objects;
+
+  while (object != NULL) {
+    if (object->isMarked) {
+      object->isMarked = false;
+      previous = object;
+      object = object->next;
+    } else {
+      Obj* unreached = object;
+      object = object->next;
+      if (previous != NULL) {
+        previous->next = object;
+      } else {
+        vm.objects = object;
+      }
+      freeObject(unreached);
+    }
+  }
+}
+
+static void traceRefs() {
+  while (vm.grayCount > 0) {
+    Obj* object = vm.grayStack[--vm.grayCount];
+    blackenObject(object);
+  }
+}
+
+// frees the unmarked nursery and promotes the survivors: anything that
+// lived through one collection moves to the old list and stops being
+// traced by minor ones. During a major collection this runs after
+// sweep() so the freshly promoted (and already unmarked) objects
+// aren't re-examined.
+static void sweepYoung() {
+  Obj* object = vm.youngObjects;
+  vm.youngObjects = NULL;
+  while (object != NULL) {
+    Obj* next = object->next;
+    if (object->isMarked) {
+      object->isMarked = false;
+      object->isOld = true;
+      object->next = vm.objects;
+      vm.objects = object;
+    } else {
+      freeObject(object);
+    }
+    object = next;
+  }
+}
+
+// every nursery survivor was just promoted, so no old object can point
+// at a young one anymore: the remembered set starts over.
+static void resetRemembered() {
+  for (int i = 0; i < vm.rememberedCount; i++) {
+    vm.remembered[i]->isRemembered = false;
+  }
+  vm.rememberedCount = 0;
+  vm.youngBytes = 0;
+}
+
+void collectGarbageMinor() {
+#ifdef DEBUG_LOG_GC
+  printf("-- minor gc begin\n");
+#endif
+  clock_t start = clock();
+
+  vm.gcMinor = true;
+  markRoots();
+  // re-trace the old objects the write barrier caught: their young
+  // referents are live even if nothing young-reachable points at them.
+  for (int i = 0; i < vm.rememberedCount; i++) {
+    blackenObject(vm.remembered[i]);
+  }
+  traceRefs();
+  // old interned strings are unmarked but implicitly live; only young
+  // keys face this sweep.
+  tableRemoveWhite(&vm.strings, true);
+  sweepYoung();
+  resetRemembered();
+  vm.gcMinor = false;
+
+  double pauseMs = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+  vm.gcMinorCount++;
+  vm.gcLastPauseMs = pauseMs;
+  vm.gcTotalPauseMs += pauseMs;
+
+#ifdef DEBUG_LOG_GC
+  printf("-- minor gc end\n");
+#endif
+}
+
+static void markArray(ValueArray* array) {
+  for (int i = 0; i < array->count; i++) {
+    markValue(array->values[i]);
+  }
+}
+
+void collectGarbage() {
+#ifdef DEBUG_LOG_GC
+  printf("-- gc begin\n");
+  size_t before = vm.bytesAllocated;
+#endif
+  clock_t start = clock();
+
+  markRoots();
+  traceRefs();
+  // the intern table holds its keys weakly: entries whose strings
+  // didn't survive the trace are unlinked before the sweep frees them.
+  tableRemoveWhite(&vm.strings, false);
+  // reset before the sweep: an unreachable remembered object is about
+  // to be freed, and clearing its flag afterwards would write through
+  // a dangling pointer.
+  resetRemembered();
+  sweep();
+  // a major collection drains the nursery too; with every survivor
+  // promoted, the remembered set starts over empty.
+  sweepYoung();
+
+  vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
+
+  double pauseMs = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+  vm.gcCount++;
+  vm.gcLastPauseMs = pauseMs;
+  vm.gcTotalPauseMs += pauseMs;
+
+#ifdef DEBUG_LOG_GC
+  printf("\n-- gc end\n");
+  printf("   collected %zu bytes (from %zu to %zu) next at %zu\n",
+         before - vm.bytesAllocated, before, vm.bytesAllocated, vm.nextGC);
+#endif
+}
+
+void markValue(Value val) {
+  if (!IS_OBJ(val))
+    return;
+  markObject(AS_OBJ(val));
+}
+
+void markObject(Obj* object) {
+  if (object == NULL)
+    return;
+  if (object->isMarked)
+    return;
+  // during a minor collection the old generation is implicitly live:
+  // old objects are neither traced nor swept, and any young objects
+  // they reference were caught by the write barrier.
+  if (vm.gcMinor && object->isOld)
+    return;
+#ifdef DEBUG_LOG_GC
+  printf("%p mark ", (void*)object);
+  printValue(OBJ_VAL(object));
+  printf("\n");
+#endif
+  object->isMarked = true;
+
+  if (vm.grayCapacity < vm.grayCount + 1) {
+    vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
+    vm.grayStack = realloc(vm.grayStack, sizeof(Obj*) * vm.grayCapacity);
+    if (vm.grayStack == NULL)
+      exit(1);
+  }
+  vm.grayStack[vm.grayCount++] = object;
 }
\ No newline at end of file
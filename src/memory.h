@@ -1,31 +1,45 @@
-#ifndef clox_memory_h
-#define clox_memory_h
-#include "common.h"
-#include "value.h"
-
-#define ALLOCATE(type, count) (type*)reallocate(NULL, 0, (count) * sizeof(type))
-
-#define ALLOCATE_OBJ(type, objectType)                                         \
-  (type*)allocateObject(sizeof(type), objectType)
-
-#define GROW_CAPACITY(capacity) (((capacity) < 8) ? 8 : (capacity)*2)
-
-#define FREE(type, ptr) reallocate(ptr, sizeof(type), 0)
-
-void* reallocate(void* pointer, size_t oldCapacity, size_t newCapacity);
-void freeObjects();
-void collectGarbage();
-void markValue(Value value);
-void markObject(Obj* object);
-
-// moves a bunch of bytes from one position in memory to
-// a larger position in memory with more empty space
-
-#define GROW_ARRAY(arr, type, oldCapacity, newCapacity)                        \
-  (type*)reallocate(arr, sizeof(type) * (oldCapacity),                         \
-                    sizeof(type) * (newCapacity))
-
-#define FREE_ARRAY(arr, type, oldCount)                                        \
-  reallocate(arr, sizeof(type) * (oldCount), 0)
-
+#ifndef clox_memory_h
+#define clox_memory_h
+#include "common.h"
+#include "value.h"
+
+#define ALLOCATE(type, count) (type*)reallocate(NULL, 0, (count) * sizeof(type))
+
+#define ALLOCATE_OBJ(type, objectType)                                         \
+  (type*)allocateObject(sizeof(type), objectType)
+
+#define GROW_CAPACITY(capacity) (((capacity) < 8) ? 8 : (capacity)*2)
+
+#define FREE(type, ptr) reallocate(ptr, sizeof(type), 0)
+
+void* reallocate(void* pointer, size_t oldCapacity, size_t newCapacity);
+// slab-backed pool for object-sized allocations; larger requests fall
+// through to reallocate.
+void* poolAllocate(size_t size);
+void poolFree(void* pointer, size_t size);
+void freePools();
+void freeObjects();
+void collectGarbage();
+// sweeps only the nursery, treating the old generation (plus the
+// remembered set) as roots; survivors are promoted.
+void collectGarbageMinor();
+void markValue(Value value);
+void markObject(Obj* object);
+// write barriers for the generational collector: call after storing a
+// reference into a heap object that may be old. gcRemember is the
+// unconditional form for containers whose new contents aren't a single
+// value (a fiber parking its stack).
+void gcWriteBarrier(Obj* container, Value value);
+void gcRemember(Obj* container);
+
+// moves a bunch of bytes from one position in memory to
+// a larger position in memory with more empty space
+
+#define GROW_ARRAY(arr, type, oldCapacity, newCapacity)                        \
+  (type*)reallocate(arr, sizeof(type) * (oldCapacity),                         \
+                    sizeof(type) * (newCapacity))
+
+#define FREE_ARRAY(arr, type, oldCount)                                        \
+  reallocate(arr, sizeof(type) * (oldCount), 0)
+
 #endif
\ No newline at end of file
@@ -10,11 +10,15 @@
 #include "vm.h"
 
 static Obj* allocateObject(size_t size, ObjType type) {
-  Obj* object = (Obj*)reallocate(NULL, 0, size);
+  Obj* object = (Obj*)poolAllocate(size);
   object->type = type;
-  object->next = vm.objects;
+  // born young: minor collections sweep this list and promote the
+  // survivors into vm.objects.
+  object->next = vm.youngObjects;
   object->isMarked = false;
-  vm.objects = object;
+  object->isOld = false;
+  object->isRemembered = false;
+  vm.youngObjects = object;
 
 #ifdef DEBUG_LOG_GC
   printf("%p allocate %ld for %d\n", (void*)object, size, type);
@@ -25,8 +29,13 @@ static Obj* allocateObject(size_t size, ObjType type) {
 
 // allocate an object without storing it to the VM's object linked list
 static Obj* xallocateObject(size_t size, ObjType type) {
-  Obj* object = (Obj*)reallocate(NULL, 0, size);
+  Obj* object = (Obj*)poolAllocate(size);
   object->type = type;
+  // the object may still end up in the heap via storeString, so the
+  // GC bits can't be left as whatever the allocator handed back.
+  object->isMarked = false;
+  object->isOld = false;
+  object->isRemembered = false;
   return object;
 }
 
@@ -67,8 +76,8 @@ static void writeToString(ObjString* string, const char* chars) {
 
 static void storeString(ObjString* string) {
   tableSet(&vm.strings, string, NIL_VAL);
-  ((Obj*)string)->next = vm.objects;
-  vm.objects = (Obj*)string;
+  ((Obj*)string)->next = vm.youngObjects;
+  vm.youngObjects = (Obj*)string;
 }
 
 // creates a string object without initializing the character array,
@@ -91,8 +100,9 @@ ObjString* validateString(ObjString* string) {
   ObjString* interned =
       tableFindString(&vm.strings, string->chars, string->length, string->hash);
   if (interned != NULL) {
-    // TODO: free the parameter string from memory
-    free(string);
+    // the string was never threaded into the VM's object list, so it
+    // just needs handing back to the pool it came out of.
+    poolFree(string, sizeof(ObjString) + string->length + 1);
     return interned;
   }
   // if not interned, add it to the head of VM's
@@ -121,7 +131,11 @@ ObjFunction* newFunction() {
   ObjFunction* func = ALLOCATE_OBJ(ObjFunction, OBJ_FUNCTION);
   func->arity = 0;
   func->upvalueCount = 0;
+  func->maxStack = 1;
   func->name = NULL;
+  func->profCalls = 0;
+  func->profInclMs = 0.0;
+  func->profExclMs = 0.0;
   initChunk(&func->chunk);
   return func;
 }
@@ -133,19 +147,116 @@ ObjNative* newNative(NativeFn function) {
 }
 
 ObjClosure* newClosure(ObjFunction* func) {
-  ObjClosure* closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
-  closure->function = func;
+  // allocate the upvalue array first: if it triggered a collection
+  // after the closure existed, the unrooted closure would be swept.
   ObjUpvalue** upvalues = ALLOCATE(ObjUpvalue*, func->upvalueCount);
 
   for (int i = 0; i < func->upvalueCount; i++) {
     upvalues[i] = NULL;
   }
 
+  ObjClosure* closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
+  closure->function = func;
   closure->upvalues = upvalues;
   closure->upvalueCount = func->upvalueCount;
   return closure;
 }
 
+static int charLength(Obj* object) {
+  return object->type == OBJ_STRING ? ((ObjString*)object)->length
+                                    : ((ObjRope*)object)->length;
+}
+
+// both children must be rooted by the caller (on the VM stack) since
+// this allocates.
+ObjRope* newRope(Obj* left, Obj* right) {
+  ObjRope* rope = ALLOCATE_OBJ(ObjRope, OBJ_ROPE);
+  rope->length = charLength(left) + charLength(right);
+  rope->left = left;
+  rope->right = right;
+  rope->flat = NULL;
+  return rope;
+}
+
+// copies a string or rope into `dest`. Right children are written by
+// recursing, then the loop walks on down the left spine - append loops
+// build left-leaning ropes, so the deep side costs no call stack.
+static void writeFlat(char* dest, Obj* object) {
+  for (;;) {
+    if (object->type == OBJ_STRING) {
+      ObjString* string = (ObjString*)object;
+      memcpy(dest, string->chars, string->length);
+      return;
+    }
+
+    ObjRope* rope = (ObjRope*)object;
+    if (rope->flat != NULL) {
+      object = (Obj*)rope->flat;
+      continue;
+    }
+
+    int rightLength = charLength(rope->right);
+    writeFlat(dest + rope->length - rightLength, rope->right);
+    object = rope->left;
+  }
+}
+
+// forces a rope down to a real interned string (plain strings pass
+// through). The object must be rooted by the caller: building the flat
+// string allocates and can trigger a collection.
+ObjString* flattenString(Obj* object) {
+  if (object->type == OBJ_STRING)
+    return (ObjString*)object;
+
+  ObjRope* rope = (ObjRope*)object;
+  if (rope->flat != NULL)
+    return rope->flat;
+
+  ObjString* flat = xallocateString(rope->length);
+  writeFlat(flat->chars, object);
+  flat->hash = hashString(flat->chars, flat->length);
+  flat = validateString(flat);
+  rope->flat = flat;
+  // an old rope caching a fresh flat string is exactly the store a
+  // minor collection can't see on its own.
+  gcWriteBarrier((Obj*)rope, OBJ_VAL(flat));
+  return flat;
+}
+
+// ropes aren't interned, so equality involving one compares the
+// flattened (and therefore interned) representations by pointer.
+bool stringLikeEquals(Value a, Value b) {
+  if (!IS_STRINGLIKE(a) || !IS_STRINGLIKE(b))
+    return false;
+  return flattenString(AS_OBJ(a)) == flattenString(AS_OBJ(b));
+}
+
+ObjArray* newArray() {
+  ObjArray* array = ALLOCATE_OBJ(ObjArray, OBJ_ARRAY);
+  initValueArray(&array->elements);
+  return array;
+}
+
+// `function` is the fiber's entry point and `closure` its wrapper if
+// it captures (both NULL for the root fiber that parks the main
+// script). The stack and frame buffers are allocated on first resume,
+// so fibers that are created but never run cost only the object
+// itself.
+ObjFiber* newFiber(ObjClosure* closure, ObjFunction* function) {
+  ObjFiber* fiber = ALLOCATE_OBJ(ObjFiber, OBJ_FIBER);
+  fiber->closure = closure;
+  fiber->function = function;
+  fiber->state = FIBER_NEW;
+  fiber->caller = NULL;
+  fiber->stack.values = NULL;
+  fiber->stack.top = NULL;
+  fiber->stack.size = 0;
+  fiber->frames = NULL;
+  fiber->frameCount = 0;
+  fiber->openUpvalues = NULL;
+  return fiber;
+}
+
 ObjUpvalue* newUpvalue(Value* slot) {
   ObjUpvalue* upval = ALLOCATE_OBJ(ObjUpvalue, OBJ_UPVALUE);
   upval->slot = slot;
@@ -180,5 +291,22 @@ void printObject(Value value) {
   case OBJ_UPVALUE:
     printf("upvalue");
     break;
+  case OBJ_ROPE:
+    printf("%s", flattenString(AS_OBJ(value))->chars);
+    break;
+  case OBJ_ARRAY: {
+    ObjArray* array = AS_ARRAY(value);
+    printf("[");
+    for (int i = 0; i < array->elements.count; i++) {
+      if (i > 0)
+        printf(", ");
+      printValue(array->elements.values[i]);
+    }
+    printf("]");
+    break;
+  }
+  case OBJ_FIBER:
+    printf("<fiber>");
+    break;
   }
 }
\ No newline at end of file
@@ -11,25 +11,43 @@
 #define IS_FUNCTION(value) isObjType(value, OBJ_FUNCTION)
 #define IS_NATIVE(value) isObjType(value, OBJ_NATIVE)
 #define IS_CLOSURE(value) isObjType(value, OBJ_CLOSURE)
+#define IS_ROPE(value) isObjType(value, OBJ_ROPE)
+#define IS_ARRAY(value) isObjType(value, OBJ_ARRAY)
+#define IS_FIBER(value) isObjType(value, OBJ_FIBER)
+// anything `+` accepts as a string operand: a plain string or a rope.
+#define IS_STRINGLIKE(value) (IS_STRING(value) || IS_ROPE(value))
 
 #define AS_FUNCTION(value) ((ObjFunction*)AS_OBJ(value))
 #define AS_STRING(value) ((ObjString*)AS_OBJ(value))
 #define AS_NATIVE(value) (((ObjNative*)AS_OBJ(value))->function)
 #define AS_CSTRING(value) (((ObjString*)AS_OBJ(value))->chars)
 #define AS_CLOSURE(value) ((ObjClosure*)AS_OBJ(value))
+#define AS_ROPE(value) ((ObjRope*)AS_OBJ(value))
+#define AS_ARRAY(value) ((ObjArray*)AS_OBJ(value))
+#define AS_FIBER(value) ((ObjFiber*)AS_OBJ(value))
 
 typedef enum {
   OBJ_STRING,
   OBJ_FUNCTION,
   OBJ_NATIVE,
   OBJ_CLOSURE,
-  OBJ_UPVALUE
+  OBJ_UPVALUE,
+  OBJ_ROPE,
+  OBJ_ARRAY,
+  OBJ_FIBER
 } ObjType;
 
 struct sObj {
   ObjType type;
   struct sObj* next;
   bool isMarked;
+  // generation: objects are born young (on vm.youngObjects) and move
+  // to the old list when they survive a collection. Objects don't move
+  // in memory - only between the two lists.
+  bool isOld;
+  // old object already on the remembered set this cycle, so the write
+  // barrier doesn't append it twice.
+  bool isRemembered;
 };
 
 typedef struct {
@@ -37,7 +55,15 @@ typedef struct {
   int arity;
   Chunk chunk;
   int upvalueCount;
+  // total frame requirement in stack slots (callee + parameters +
+  // deepest operand stack), computed by the compiler so call() can
+  // reserve it once and pushes inside the frame skip bounds checks.
+  int maxStack;
   ObjString* name;
+  // only written in --profile mode; see profiler.h.
+  int profCalls;
+  double profInclMs;
+  double profExclMs;
 } ObjFunction;
 
 typedef struct ObjUpvalue {
@@ -69,6 +95,73 @@ struct sObjString {
   char chars[];
 };
 
+// a deferred concatenation: `left + right` without copying either side.
+// The children are strings or further ropes, so a loop of appends
+// builds a left-leaning tree in O(1) per `+` instead of recopying the
+// accumulated prefix. The tree is flattened into a real (interned)
+// string only when something needs the characters, and the result is
+// cached in `flat`.
+typedef struct {
+  Obj obj;
+  int length;
+  Obj* left;
+  Obj* right;
+  ObjString* flat;
+} ObjRope;
+
+// a contiguous, growable array of Values: [1, 2, 3] in source.
+// Appends go through writeValueArray, so growth doubles amortized.
+typedef struct {
+  Obj obj;
+  ValueArray elements;
+} ObjArray;
+
+#define FRAMES_MAX 64
+
+typedef struct {
+  // NULL when a zero-upvalue ObjFunction is called directly (the
+  // compiler elides the closure wrapper for those); the upvalue
+  // opcodes only ever run inside functions that do capture, so they
+  // always find a real closure here.
+  ObjClosure* closure;
+  ObjFunction* function;
+  uint8_t* ip;
+  // the first slot that this function
+  // can use;
+  Value* slots;
+} CallFrame;
+
+typedef enum {
+  FIBER_NEW,       // created but never resumed
+  FIBER_RUNNING,   // its state is currently loaded in the VM
+  FIBER_SUSPENDED, // parked at a yield (or a pending resume)
+  FIBER_DONE       // its entry function returned; not resumable
+} FiberState;
+
+// an independent thread of Lox execution with its own value stack and
+// call frames, multiplexed cooperatively on the host thread. The VM
+// runs exactly one fiber at a time; resume/yield park the active
+// stack/frames/upvalues here and load another fiber's. The buffers
+// change hands rather than being copied, so a fiber's saved pointers
+// are valid only while it is suspended.
+typedef struct ObjFiber {
+  Obj obj;
+  // the entry point; function is NULL only for the synthetic fiber
+  // that parks the main script, closure also when the entry is a bare
+  // (zero-upvalue) ObjFunction.
+  ObjClosure* closure;
+  ObjFunction* function;
+  FiberState state;
+  // the fiber that resumed this one, where control (and the yielded
+  // or returned value) goes back to.
+  struct ObjFiber* caller;
+  // execution state, owned while suspended (NULL/empty otherwise).
+  ValueStack stack;
+  CallFrame* frames;
+  int frameCount;
+  ObjUpvalue* openUpvalues;
+} ObjFiber;
+
 ObjFunction* newFunction();
 ObjClosure* newClosure(ObjFunction* function);
 ObjUpvalue* newUpvalue(Value* slot);
@@ -77,6 +170,11 @@ ObjString* takeString(char* chars, int length);
 ObjString* copyString(const char* chars, int length);
 ObjString* xallocateString(int length);
 ObjString* validateString(ObjString* string);
+ObjRope* newRope(Obj* left, Obj* right);
+ObjArray* newArray();
+ObjFiber* newFiber(ObjClosure* closure, ObjFunction* function);
+ObjString* flattenString(Obj* object);
+bool stringLikeEquals(Value a, Value b);
 void printObject(Value object);
 
 static inline bool isObjType(Value value, ObjType type) {
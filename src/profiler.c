@@ -0,0 +1,362 @@
+#include "profiler.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#endif
+
+#include "chunk.h"
+#include "memory.h"
+#include "vm.h"
+
+bool profileEnabled = false;
+bool sampleEnabled = false;
+_Thread_local uint64_t profileOpcodeCounts[UINT8_MAX + 1];
+
+// the shadow call stack: one entry per active VM frame, tracking when
+// the frame started and how much time its callees have consumed so
+// far (so exclusive time is elapsed minus child time).
+typedef struct {
+  ObjFunction* function;
+  double startMs;
+  double childMs;
+} ProfileFrame;
+
+static _Thread_local ProfileFrame callStack[FRAMES_MAX];
+static _Thread_local int depth = 0;
+
+static double nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+void profileCall(ObjFunction* function) {
+  function->profCalls++;
+  if (depth < FRAMES_MAX) {
+    callStack[depth].function = function;
+    callStack[depth].startMs = nowMs();
+    callStack[depth].childMs = 0.0;
+  }
+  depth++;
+}
+
+void profileReturn() {
+  depth--;
+  if (depth < 0 || depth >= FRAMES_MAX)
+    return;
+
+  ProfileFrame* frame = &callStack[depth];
+  double elapsed = nowMs() - frame->startMs;
+  // the function is still referenced from the VM frame being popped,
+  // so the pointer is live here.
+  frame->function->profInclMs += elapsed;
+  frame->function->profExclMs += elapsed - frame->childMs;
+  if (depth > 0)
+    callStack[depth - 1].childMs += elapsed;
+}
+
+/*
+  The sampling profiler. A SIGPROF interval timer fires every
+  millisecond of CPU time; the handler walks vm.frames - the same walk
+  runtimeError() does to print a stack trace - and folds the stack into
+  a fixed open-addressed table right there, so capture needs no
+  allocation and costs nothing between ticks. SIGPROF is delivered on a
+  running thread, and vm is thread-local, so the handler always sees
+  the frame array of the thread it interrupted, parked at some
+  instruction boundary. A tick that lands mid call setup can be off by
+  one frame; at this rate that noise doesn't survive aggregation.
+*/
+
+#define SAMPLE_INTERVAL_USEC 1000
+// power of two; a full table drops further distinct stacks (counted).
+#define SAMPLE_TABLE_SIZE 1024
+
+// one distinct call stack and how often it was observed. depth == 0
+// marks an empty slot, and is written last so a mark pass interrupted
+// by the handler never reads a half-filled entry.
+typedef struct {
+  uint64_t count;
+  int leafLine;
+  int depth;
+  ObjFunction* frames[FRAMES_MAX];
+} SampleEntry;
+
+static SampleEntry sampleTable[SAMPLE_TABLE_SIZE];
+static uint64_t sampleTaken = 0;
+static uint64_t sampleDropped = 0;
+
+// nonzero while the VM is swapping whole frame arrays (fiber
+// switches); a tick in that window would read torn state, so it's
+// dropped instead.
+static volatile sig_atomic_t samplePaused = 0;
+
+void samplePause() {
+  samplePaused = 1;
+  SAMPLE_FENCE();
+}
+
+void sampleResume() {
+  SAMPLE_FENCE();
+  samplePaused = 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static void sampleHandler(int sig) {
+  (void)sig;
+  if (samplePaused) {
+    sampleDropped++;
+    return;
+  }
+  int depth = vm.frameCount;
+  if (depth <= 0 || depth > FRAMES_MAX)
+    return;
+
+  ObjFunction* frames[FRAMES_MAX];
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < depth; i++) {
+    frames[i] = vm.frames[i].function;
+    // the arrays are zeroed at allocation and frames publish before
+    // frameCount, but stay defensive: a NULL here means torn state.
+    if (frames[i] == NULL) {
+      sampleDropped++;
+      return;
+    }
+    hash = (hash ^ (uint32_t)(uintptr_t)frames[i]) * 16777619;
+  }
+
+  // getLine is a binary search over the chunk's line runs: pure reads,
+  // safe from a handler.
+  CallFrame* leaf = &vm.frames[depth - 1];
+  int line = getLine(&leaf->function->chunk,
+                     (int)(leaf->ip - leaf->function->chunk.code - 1));
+  hash = (hash ^ (uint32_t)line) * 16777619;
+
+  uint32_t slot = hash & (SAMPLE_TABLE_SIZE - 1);
+  for (int probe = 0; probe < SAMPLE_TABLE_SIZE; probe++) {
+    SampleEntry* entry = &sampleTable[slot];
+    if (entry->depth == 0) {
+      entry->count = 1;
+      entry->leafLine = line;
+      memcpy(entry->frames, frames, sizeof(ObjFunction*) * depth);
+      entry->depth = depth;
+      sampleTaken++;
+      return;
+    }
+    if (entry->depth == depth && entry->leafLine == line &&
+        memcmp(entry->frames, frames, sizeof(ObjFunction*) * depth) == 0) {
+      entry->count++;
+      sampleTaken++;
+      return;
+    }
+    slot = (slot + 1) & (SAMPLE_TABLE_SIZE - 1);
+  }
+  sampleDropped++;
+}
+#endif
+
+void sampleStart() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct sigaction sa;
+  sa.sa_handler = sampleHandler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGPROF, &sa, NULL);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = SAMPLE_INTERVAL_USEC;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+#else
+  fprintf(stderr, "--sample needs a POSIX platform; flag ignored.\n");
+  sampleEnabled = false;
+#endif
+}
+
+// the table holds raw ObjFunction pointers between ticks and the dump,
+// so the GC pins them: the set is bounded by distinct stacks, not by
+// sample count, and the functions are on vm.frames (already a root)
+// the moment they're captured anyway.
+void sampleMarkRoots() {
+  if (!sampleEnabled)
+    return;
+  for (int i = 0; i < SAMPLE_TABLE_SIZE; i++) {
+    SampleEntry* entry = &sampleTable[i];
+    for (int j = 0; j < entry->depth; j++)
+      markObject((Obj*)entry->frames[j]);
+  }
+}
+
+void sampleDump() {
+  if (!sampleEnabled)
+    return;
+
+#if defined(__unix__) || defined(__APPLE__)
+  struct itimerval off = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_PROF, &off, NULL);
+  signal(SIGPROF, SIG_IGN);
+#endif
+
+  FILE* out = fopen("clox.folded", "w");
+  if (out == NULL) {
+    fprintf(stderr, "Could not write samples to 'clox.folded'.\n");
+    return;
+  }
+
+  int distinct = 0;
+  for (int i = 0; i < SAMPLE_TABLE_SIZE; i++) {
+    SampleEntry* entry = &sampleTable[i];
+    if (entry->depth == 0)
+      continue;
+    distinct++;
+    for (int j = 0; j < entry->depth; j++) {
+      ObjFunction* function = entry->frames[j];
+      fprintf(out, "%s%s", j > 0 ? ";" : "",
+              function->name != NULL ? function->name->chars : "<script>");
+    }
+    // the leaf keeps its source line, so a flamegraph splits hot
+    // functions by the line that was executing.
+    fprintf(out, ":%d %llu\n", entry->leafLine,
+            (unsigned long long)entry->count);
+  }
+  fclose(out);
+
+  fprintf(stderr, "-- sample: %llu samples, %d stacks -> clox.folded --\n",
+          (unsigned long long)sampleTaken, distinct);
+  if (sampleDropped > 0) {
+    fprintf(stderr, "   (%llu samples dropped: stack table full)\n",
+            (unsigned long long)sampleDropped);
+  }
+}
+
+static const char* opcodeNames[UINT8_MAX + 1] = {
+    [OP_RETURN] = "OP_RETURN",
+    [OP_CONSTANT] = "OP_CONSTANT",
+    [OP_NIL] = "OP_NIL",
+    [OP_NOT] = "OP_NOT",
+    [OP_TRUE] = "OP_TRUE",
+    [OP_FALSE] = "OP_FALSE",
+    [OP_EQUAL] = "OP_EQUAL",
+    [OP_LESS] = "OP_LESS",
+    [OP_GREATER] = "OP_GREATER",
+    [OP_NEGATE] = "OP_NEGATE",
+    [OP_MULT] = "OP_MULT",
+    [OP_DIV] = "OP_DIV",
+    [OP_ADD] = "OP_ADD",
+    [OP_SUB] = "OP_SUB",
+    [OP_PRINT] = "OP_PRINT",
+    [OP_POP] = "OP_POP",
+    [OP_POPN] = "OP_POPN",
+    [OP_DEFINE_GLOBAL] = "OP_DEFINE_GLOBAL",
+    [OP_GET_GLOBAL] = "OP_GET_GLOBAL",
+    [OP_SET_GLOBAL] = "OP_SET_GLOBAL",
+    [OP_SET_LOCAL] = "OP_SET_LOCAL",
+    [OP_GET_LOCAL] = "OP_GET_LOCAL",
+    [OP_JUMPZ] = "OP_JUMPZ",
+    [OP_JUMP] = "OP_JUMP",
+    [OP_LOOP] = "OP_LOOP",
+    [OP_CALL] = "OP_CALL",
+    [OP_CLOSURE] = "OP_CLOSURE",
+    [OP_GET_UPVALUE] = "OP_GET_UPVALUE",
+    [OP_SET_UPVALUE] = "OP_SET_UPVALUE",
+    [OP_CLOSE_UPVALUE] = "OP_CLOSE_UPVALUE",
+    [OP_DEFINE_GLOBAL_SLOT] = "OP_DEFINE_GLOBAL_SLOT",
+    [OP_GET_GLOBAL_SLOT] = "OP_GET_GLOBAL_SLOT",
+    [OP_SET_GLOBAL_SLOT] = "OP_SET_GLOBAL_SLOT",
+    [OP_NOT_EQUAL] = "OP_NOT_EQUAL",
+    [OP_GREATER_EQUAL] = "OP_GREATER_EQUAL",
+    [OP_LESS_EQUAL] = "OP_LESS_EQUAL",
+    [OP_ADD_CONST] = "OP_ADD_CONST",
+    [OP_TAIL_CALL] = "OP_TAIL_CALL",
+    [OP_ARRAY] = "OP_ARRAY",
+    [OP_INDEX_GET] = "OP_INDEX_GET",
+    [OP_INDEX_SET] = "OP_INDEX_SET",
+    [OP_CONSTANT_LONG] = "OP_CONSTANT_LONG",
+    [OP_DEFINE_GLOBAL_LONG] = "OP_DEFINE_GLOBAL_LONG",
+    [OP_GET_GLOBAL_LONG] = "OP_GET_GLOBAL_LONG",
+    [OP_SET_GLOBAL_LONG] = "OP_SET_GLOBAL_LONG",
+    [OP_ADD_NUM] = "OP_ADD_NUM",
+    [OP_ADD_STR] = "OP_ADD_STR",
+    [OP_LESS_NUM] = "OP_LESS_NUM",
+    [OP_GREATER_NUM] = "OP_GREATER_NUM",
+    [OP_INLINE_GUARD] = "OP_INLINE_GUARD",
+};
+
+static int compareOpcodeCounts(const void* a, const void* b) {
+  uint64_t countA = profileOpcodeCounts[*(const uint8_t*)a];
+  uint64_t countB = profileOpcodeCounts[*(const uint8_t*)b];
+  return countA < countB ? 1 : countA > countB ? -1 : 0;
+}
+
+static int compareFunctions(const void* a, const void* b) {
+  double exclA = (*(ObjFunction* const*)a)->profExclMs;
+  double exclB = (*(ObjFunction* const*)b)->profExclMs;
+  return exclA < exclB ? 1 : exclA > exclB ? -1 : 0;
+}
+
+void profileDump() {
+  if (!profileEnabled)
+    return;
+
+  fprintf(stderr, "-- profile: opcodes --\n");
+  uint8_t order[UINT8_MAX + 1];
+  for (int i = 0; i <= UINT8_MAX; i++)
+    order[i] = (uint8_t)i;
+  qsort(order, UINT8_MAX + 1, sizeof(uint8_t), compareOpcodeCounts);
+
+  uint64_t total = 0;
+  for (int i = 0; i <= UINT8_MAX; i++)
+    total += profileOpcodeCounts[i];
+
+  for (int i = 0; i <= UINT8_MAX; i++) {
+    uint64_t count = profileOpcodeCounts[order[i]];
+    if (count == 0)
+      break;
+    const char* name = opcodeNames[order[i]];
+    fprintf(stderr, "%12llu  %5.1f%%  %s\n", (unsigned long long)count,
+            100.0 * count / total, name != NULL ? name : "?");
+  }
+
+  // collect every function the GC still knows about - both
+  // generations - ones collected mid-run take their numbers with them,
+  // which in practice only loses anonymous short-lived helpers.
+  Obj* lists[] = {vm.objects, vm.youngObjects};
+  int count = 0;
+  for (int l = 0; l < 2; l++) {
+    for (Obj* object = lists[l]; object != NULL; object = object->next) {
+      if (object->type == OBJ_FUNCTION &&
+          ((ObjFunction*)object)->profCalls > 0) {
+        count++;
+      }
+    }
+  }
+
+  ObjFunction** functions = malloc(sizeof(ObjFunction*) * count);
+  int at = 0;
+  for (int l = 0; l < 2; l++) {
+    for (Obj* object = lists[l]; object != NULL; object = object->next) {
+      if (object->type == OBJ_FUNCTION &&
+          ((ObjFunction*)object)->profCalls > 0) {
+        functions[at++] = (ObjFunction*)object;
+      }
+    }
+  }
+  qsort(functions, count, sizeof(ObjFunction*), compareFunctions);
+
+  fprintf(stderr, "-- profile: functions --\n");
+  fprintf(stderr, "%12s %12s %12s  %s\n", "calls", "incl_ms", "excl_ms",
+          "function");
+  for (int i = 0; i < count; i++) {
+    ObjFunction* function = functions[i];
+    fprintf(stderr, "%12d %12.3f %12.3f  %s\n", function->profCalls,
+            function->profInclMs, function->profExclMs,
+            function->name != NULL ? function->name->chars : "<script>");
+  }
+  free(functions);
+}
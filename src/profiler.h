@@ -0,0 +1,61 @@
+#ifndef clox_profiler_h
+#define clox_profiler_h
+
+#include "common.h"
+#include "object.h"
+
+/*
+  Execution profiler, enabled with `clox --profile script.lox`.
+
+  Two kinds of data are kept while the flag is on:
+    - a per-opcode execution histogram, bumped once per dispatched
+      instruction from the interpreter loop;
+    - per-function invocation counts and inclusive/exclusive wall time,
+      measured by a shadow call stack that mirrors the VM's frames.
+  freeVM() dumps both as sorted reports on stderr. Inclusive time for
+  directly recursive functions counts each active frame, the usual
+  caveat for this kind of profile.
+
+  `clox --sample script.lox` runs the sampling profiler instead: a
+  SIGPROF timer periodically captures the VM's frame array with zero
+  instrumentation in the dispatch loop, and freeVM() writes the
+  aggregated stacks to clox.folded in the folded format flamegraph
+  tooling consumes ("main;f;g 42", one line per distinct stack).
+*/
+
+// set once at startup, before any isolate threads exist.
+extern bool profileEnabled;
+extern bool sampleEnabled;
+// per-thread, like the rest of the VM state.
+extern _Thread_local uint64_t profileOpcodeCounts[];
+
+// lives inside the dispatch loop, so it must stay one predictable
+// branch plus one increment.
+#define PROFILE_OP(op)                                                         \
+  do {                                                                         \
+    if (profileEnabled)                                                        \
+      profileOpcodeCounts[op]++;                                               \
+  } while (false)
+
+void profileCall(ObjFunction* function);
+void profileReturn();
+void profileDump();
+
+void sampleStart();
+void sampleDump();
+void sampleMarkRoots();
+// bracket windows where vm.frames/vm.frameCount are mid-swap (fiber
+// switches); the handler drops any sample landing inside one.
+void samplePause();
+void sampleResume();
+
+// compiler-only fence for publishing frames to the sampler: the
+// handler interrupts this same thread, so ordering the emitted stores
+// is enough - no hardware barrier needed.
+#if defined(__GNUC__)
+#define SAMPLE_FENCE() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#else
+#define SAMPLE_FENCE()
+#endif
+
+#endif
@@ -1,44 +1,55 @@
-#ifndef clox_scanner_h
-#define clox_scanner_h
-
-// clang-format off
-typedef enum{
-  TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,                
-  TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,                
-  TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,    
-  TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR,
-
-  // One or two character tokens.                     
-  TOKEN_BANG, TOKEN_BANG_EQUAL,                       
-  TOKEN_EQUAL, TOKEN_EQUAL_EQUAL,                     
-  TOKEN_GREATER, TOKEN_GREATER_EQUAL,                 
-  TOKEN_LESS, TOKEN_LESS_EQUAL,                       
-
-  // Literals.                                        
-  TOKEN_IDENTIFIER, TOKEN_STRING, TOKEN_NUMBER,       
-
-  // Keywords.                                        
-  TOKEN_AND, TOKEN_CLASS, TOKEN_ELSE, TOKEN_FALSE,    
-  TOKEN_FOR, TOKEN_FUN, TOKEN_IF, TOKEN_NIL, TOKEN_OR,
-  TOKEN_PRINT, TOKEN_RETURN, TOKEN_SUPER, TOKEN_THIS, 
-  TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE,                 
-
-  TOKEN_ERROR,                                        
-  TOKEN_EOF                       
-} TokenType;
-// clang-format on
-
-typedef struct {
-  TokenType type;
-  // The token holds a direct pointer to
-  // the starting character in the source string
-  const char* start;
-  int length;
-  int line;
-} Token;
-
-void initScanner(const char* source);
-char* tokenToString();
-Token scanToken();
-
+#ifndef clox_scanner_h
+#define clox_scanner_h
+
+// heap-allocated source buffers must have this many readable bytes
+// after the terminating NUL: the vectorized scanner reads in aligned
+// 16-byte blocks, so the block containing the NUL can extend up to 15
+// bytes past it. (Page-aligned mappings need no padding - an aligned
+// load never crosses a page boundary.)
+#define SCANNER_PADDING 16
+
+// clang-format off
+typedef enum{
+  TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,                
+  TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,                
+  TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,    
+  TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR,
+
+  // One or two character tokens.                     
+  TOKEN_BANG, TOKEN_BANG_EQUAL,                       
+  TOKEN_EQUAL, TOKEN_EQUAL_EQUAL,                     
+  TOKEN_GREATER, TOKEN_GREATER_EQUAL,                 
+  TOKEN_LESS, TOKEN_LESS_EQUAL,                       
+
+  // Literals.                                        
+  TOKEN_IDENTIFIER, TOKEN_STRING, TOKEN_NUMBER,       
+
+  // Keywords.                                        
+  TOKEN_AND, TOKEN_CLASS, TOKEN_ELSE, TOKEN_FALSE,    
+  TOKEN_FOR, TOKEN_FUN, TOKEN_IF, TOKEN_NIL, TOKEN_OR,
+  TOKEN_PRINT, TOKEN_RETURN, TOKEN_SUPER, TOKEN_THIS, 
+  TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE,                 
+
+  TOKEN_ERROR,
+  TOKEN_EOF,
+
+  // appended after TOKEN_EOF so existing rules[] indices in the
+  // compiler stay valid.
+  TOKEN_LEFT_BRACKET, TOKEN_RIGHT_BRACKET
+} TokenType;
+// clang-format on
+
+typedef struct {
+  TokenType type;
+  // The token holds a direct pointer to
+  // the starting character in the source string
+  const char* start;
+  int length;
+  int line;
+} Token;
+
+void initScanner(const char* source);
+char* tokenToString();
+Token scanToken();
+
 #endif
\ No newline at end of file
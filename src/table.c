@@ -9,43 +9,51 @@
 
 #define TABLE_MAX_LOAD 0.75
 
+// control byte for an occupied slot: the hash's top seven bits plus a
+// set high bit, so it can never collide with META_EMPTY. Probes compare
+// this one byte before ever dereferencing the entry's key.
+#define META_EMPTY 0
+#define META_OF(hash) (uint8_t)(((hash) >> 25) | 0x80)
+
 void initTable(Table* table) {
   table->count = 0;
   table->cap = 0;
   table->entries = NULL;
+  table->meta = NULL;
 }
 
 void freeTable(Table* table) {
   FREE_ARRAY(table->entries, Entry, table->cap);
+  FREE_ARRAY(table->meta, uint8_t, table->cap);
   initTable(table);
 }
 
-static Entry* findEntry(Entry* entries, int cap, ObjString* key) {
-  uint32_t index = key->hash % cap;
-  Entry* tombstone = NULL;
+static Entry* findEntry(Entry* entries, uint8_t* meta, int cap,
+                        ObjString* key) {
+  uint32_t mask = (uint32_t)cap - 1;
+  uint32_t index = key->hash & mask;
+  uint8_t control = META_OF(key->hash);
+
   while (true) {
-    Entry* entry = &entries[index];
-
-    if (entry->key == NULL) {
-      if (IS_NIL(entry->value)) {
-        return tombstone != NULL ? tombstone : entry;
-      } else {
-        if (tombstone == NULL)
-          tombstone = entry;
-      }
-    } else if (entry->key == key) {
-      return entry;
+    if (meta[index] == META_EMPTY) {
+      return &entries[index];
     }
-
-    index = (index + 1) % cap;
+    if (meta[index] == control && entries[index].key == key) {
+      return &entries[index];
+    }
+    index = (index + 1) & mask;
   }
 }
 
 static void adjustCapacity(Table* table, int cap) {
+  // GROW_CAPACITY only ever hands out powers of two; masking depends
+  // on that.
   Entry* entries = ALLOCATE(Entry, cap);
+  uint8_t* meta = ALLOCATE(uint8_t, cap);
   for (int i = 0; i < cap; i++) {
     entries[i].key = NULL;
     entries[i].value = NIL_VAL;
+    meta[i] = META_EMPTY;
   }
 
   for (int i = 0; i < table->cap; i++) {
@@ -53,20 +61,32 @@ static void adjustCapacity(Table* table, int cap) {
     if (entry->key == NULL)
       continue;
 
-    Entry* dest = findEntry(entries, cap, entry->key);
+    Entry* dest = findEntry(entries, meta, cap, entry->key);
     dest->key = entry->key;
     dest->value = entry->value;
+    meta[dest - entries] = META_OF(entry->key->hash);
   }
 
   FREE_ARRAY(table->entries, Entry, table->cap);
+  FREE_ARRAY(table->meta, uint8_t, table->cap);
   table->entries = entries;
+  table->meta = meta;
   table->cap = cap;
 }
 
+// exposes the probe sequence for inline caches: returns the entry the
+// key lands on (which may be empty), or NULL if the table has no
+// storage yet.
+Entry* tableFindEntry(Table* table, ObjString* key) {
+  if (table->cap == 0)
+    return NULL;
+  return findEntry(table->entries, table->meta, table->cap, key);
+}
+
 bool tableGet(Table* table, ObjString* key, Value* valueOut) {
   if (table->count == 0)
     return false;
-  Entry* entry = findEntry(table->entries, table->cap, key);
+  Entry* entry = findEntry(table->entries, table->meta, table->cap, key);
   if (entry->key == NULL)
     return false;
 
@@ -80,27 +100,50 @@ bool tableSet(Table* table, ObjString* key, Value value) {
     adjustCapacity(table, cap);
   }
 
-  Entry* entry = findEntry(table->entries, table->cap, key);
+  Entry* entry = findEntry(table->entries, table->meta, table->cap, key);
 
   bool isNewKey = entry->key == NULL;
-  if (isNewKey && IS_NIL(entry->value))
+  if (isNewKey) {
     table->count++;
+    table->meta[entry - table->entries] = META_OF(key->hash);
+  }
 
   entry->key = key;
   entry->value = value;
   return isNewKey;
 }
 
+// deletion uses backward shifting instead of tombstones: entries after
+// the hole are moved back into it while that keeps them reachable from
+// their home slot, so probe chains never accumulate dead slots.
 bool tableDelete(Table* table, ObjString* key) {
   if (table->count == 0)
     return false;
 
-  Entry* entry = findEntry(table->entries, table->cap, key);
+  Entry* entry = findEntry(table->entries, table->meta, table->cap, key);
   if (entry->key == NULL)
     return false;
 
-  entry->key = NULL;
-  entry->value = BOOL_VAL(true);
+  uint32_t mask = (uint32_t)table->cap - 1;
+  uint32_t hole = (uint32_t)(entry - table->entries);
+  uint32_t index = (hole + 1) & mask;
+
+  while (table->meta[index] != META_EMPTY) {
+    uint32_t home = table->entries[index].key->hash & mask;
+    // an entry may only move into the hole if the hole still lies on
+    // the probe path from its home slot.
+    if (((index - home) & mask) >= ((index - hole) & mask)) {
+      table->entries[hole] = table->entries[index];
+      table->meta[hole] = table->meta[index];
+      hole = index;
+    }
+    index = (index + 1) & mask;
+  }
+
+  table->entries[hole].key = NULL;
+  table->entries[hole].value = NIL_VAL;
+  table->meta[hole] = META_EMPTY;
+  table->count--;
 
   return true;
 }
@@ -119,22 +162,52 @@ ObjString* tableFindString(Table* table, const char chars[], int length,
   if (table->count == 0)
     return NULL;
 
-  uint32_t index = hash % table->cap;
+  uint32_t mask = (uint32_t)table->cap - 1;
+  uint32_t index = hash & mask;
+  uint8_t control = META_OF(hash);
 
   for (;;) {
-    Entry* entry = &table->entries[index];
-
-    if (entry->key == NULL) {
-      // Stop if we find an empty non-tombstone entry.
-      if (IS_NIL(entry->value))
-        return NULL;
-    } else if (entry->key->length == length && entry->key->hash == hash &&
-               memcmp(entry->key->chars, chars, length) == 0) {
-      // We found it.
-      return entry->key;
+    // with backward-shift deletion an empty slot always ends the
+    // probe chain.
+    if (table->meta[index] == META_EMPTY)
+      return NULL;
+
+    if (table->meta[index] == control) {
+      Entry* entry = &table->entries[index];
+      if (entry->key->length == length && entry->key->hash == hash &&
+          memcmp(entry->key->chars, chars, length) == 0) {
+        // We found it.
+        return entry->key;
+      }
     }
 
-    index = (index + 1) % table->cap;
+    index = (index + 1) & mask;
+  }
+}
+
+// removes every entry whose key the sweep is about to free (i.e. is
+// unmarked), so a weak table never holds dangling strings. Runs after
+// the trace and before the sweep. Backward-shift deletion can move a
+// not-yet-visited entry into a slot the scan already passed (probe
+// chains wrap around the array), so the scan repeats until a pass
+// deletes nothing; in practice the second pass is the last.
+// youngOnly is set during minor collections, where old keys are
+// implicitly live (and therefore unmarked) and only young ones face
+// the sweep.
+void tableRemoveWhite(Table* table, bool youngOnly) {
+  bool removed = true;
+  while (removed) {
+    removed = false;
+    for (int i = 0; i < table->cap; i++) {
+      Entry* entry = &table->entries[i];
+      // deletion shifts a later entry into this slot, so keep
+      // re-checking it until a surviving (or no) key settles here.
+      while (entry->key != NULL && !entry->key->obj.isMarked &&
+             !(youngOnly && entry->key->obj.isOld)) {
+        tableDelete(table, entry->key);
+        removed = true;
+      }
+    }
   }
 }
 
@@ -144,4 +217,4 @@ void markTable(Table* table) {
     markObject((Obj*)entry->key);
     markValue(entry->value);
   }
-}
\ No newline at end of file
+}
@@ -10,18 +10,27 @@ typedef struct {
 
 typedef struct {
   int count;
+  // always a power of two, so probes index with `hash & (cap - 1)`
+  // instead of a division.
   int cap;
   Entry* entries;
+  // one control byte per slot: 0 for empty, else the top seven bits
+  // of the key's hash with the high bit set. Probes scan this compact
+  // array first and only touch the wider Entry on a match.
+  uint8_t* meta;
 } Table;
 
 void initTable(Table* table);
 void freeTable(Table* table);
 bool tableSet(Table* table, ObjString* key, Value value);
 bool tableGet(Table* table, ObjString* key, Value* valueOut);
+Entry* tableFindEntry(Table* table, ObjString* key);
 bool tableDelete(Table* table, ObjString* key);
 void tableAddAll(Table* from, Table* to);
 ObjString* tableFindString(Table* table, const char chars[], int length,
                            uint32_t hash);
+// drops entries with unmarked keys; see the GC's weak-table handling.
+void tableRemoveWhite(Table* table, bool youngOnly);
 void markTable(Table* table);
 
 #endif
\ No newline at end of file
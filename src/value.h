@@ -1,65 +1,137 @@
-#ifndef clox_value_h
-#define clox_value_h
-
-#include "common.h"
-
-typedef struct sObj Obj;
-typedef struct sObjString ObjString;
-
-typedef enum { VAL_BOOL, VAL_NIL, VAL_NUMBER, VAL_OBJ } ValueType;
-
-typedef struct {
-  ValueType type;
-  union {
-    bool boolean;
-    double number;
-    Obj* obj;
-  } as;
-} Value;
-
-// lifts the value from C's static land to Lox's dynamic land
-#define BOOL_VAL(value) ((Value){VAL_BOOL, {.boolean = value}})
-#define NIL_VAL ((Value){VAL_NIL, {.number = 0}})
-#define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
-#define OBJ_VAL(object) ((Value){VAL_OBJ, {.obj = (Obj*)object}})
-
-#define AS_BOOL(value) ((value).as.boolean)
-#define AS_NUMBER(value) ((value).as.number)
-#define AS_OBJ(value) ((value).as.obj)
-
-#define IS_BOOL(value) ((value).type == VAL_BOOL)
-#define IS_NIL(value) ((value).type == VAL_NIL)
-#define IS_NUMBER(value) ((value).type == VAL_NUMBER)
-#define IS_OBJ(value) ((value).type == VAL_OBJ)
-
-bool valuesEqual(Value a, Value b);
-
-// value array
-
-typedef struct {
-  int capacity;
-  int count;
-  Value* values;
-} ValueArray;
-
-void initValueArray(ValueArray* array);
-ValueArray* newValueArray();
-void printValue(Value value);
-void writeValueArray(ValueArray* array, Value value);
-void freeValueArray(ValueArray* array);
-
-// stack
-
-typedef struct {
-  Value* top;
-  size_t size;
-  Value* values;
-} ValueStack;
-
-void initValueStack(ValueStack* stack, size_t size);
-void freeValueStack(ValueStack* stack);
-Value popValue(ValueStack* stack);
-void pushValue(ValueStack* stack, Value value);
-void printValueStack(ValueStack* stack);
-
+#ifndef clox_value_h
+#define clox_value_h
+
+#include <string.h>
+
+#include "common.h"
+
+typedef struct sObj Obj;
+typedef struct sObjString ObjString;
+
+#ifdef NAN_BOXING
+
+/*
+  NaN boxing packs every Value into 8 bytes instead of the 16 byte
+  tagged union below. Numbers are stored directly as doubles. All other
+  values live inside a quiet NaN: the 51-bit payload is either a
+  singleton tag (nil/true/false) or, with the sign bit set, a 48-bit
+  object pointer. Since no arithmetic ever produces these bit patterns,
+  a value is a number exactly when it is not a quiet NaN of our making.
+*/
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NIL 1
+#define TAG_FALSE 2
+#define TAG_TRUE 3
+// internal marker for "no value here yet" (e.g. a declared-but-undefined
+// global slot). Never escapes to scripts.
+#define TAG_UNDEFINED 4
+
+typedef uint64_t Value;
+
+#define FALSE_VAL ((Value)(uint64_t)(QNAN | TAG_FALSE))
+#define TRUE_VAL ((Value)(uint64_t)(QNAN | TAG_TRUE))
+
+#define BOOL_VAL(value) ((value) ? TRUE_VAL : FALSE_VAL)
+#define NIL_VAL ((Value)(uint64_t)(QNAN | TAG_NIL))
+#define UNDEFINED_VAL ((Value)(uint64_t)(QNAN | TAG_UNDEFINED))
+#define NUMBER_VAL(value) numToValue(value)
+#define OBJ_VAL(object)                                                        \
+  ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(object)))
+
+#define AS_BOOL(value) ((value) == TRUE_VAL)
+#define AS_NUMBER(value) valueToNum(value)
+#define AS_OBJ(value) ((Obj*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+
+#define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
+#define IS_NIL(value) ((value) == NIL_VAL)
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
+#define IS_NUMBER(value) (((value)&QNAN) != QNAN)
+#define IS_OBJ(value) (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+
+// type punning through memcpy; compiles down to a single move
+static inline double valueToNum(Value value) {
+  double num;
+  memcpy(&num, &value, sizeof(Value));
+  return num;
+}
+
+static inline Value numToValue(double num) {
+  Value value;
+  memcpy(&value, &num, sizeof(double));
+  return value;
+}
+
+#else
+
+typedef enum {
+  VAL_BOOL,
+  VAL_NIL,
+  VAL_NUMBER,
+  VAL_OBJ,
+  // internal marker for "no value here yet" (e.g. a declared-but-undefined
+  // global slot). Never escapes to scripts.
+  VAL_UNDEFINED
+} ValueType;
+
+typedef struct {
+  ValueType type;
+  union {
+    bool boolean;
+    double number;
+    Obj* obj;
+  } as;
+} Value;
+
+// lifts the value from C's static land to Lox's dynamic land
+#define BOOL_VAL(value) ((Value){VAL_BOOL, {.boolean = value}})
+#define NIL_VAL ((Value){VAL_NIL, {.number = 0}})
+#define UNDEFINED_VAL ((Value){VAL_UNDEFINED, {.number = 0}})
+#define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
+#define OBJ_VAL(object) ((Value){VAL_OBJ, {.obj = (Obj*)object}})
+
+#define AS_BOOL(value) ((value).as.boolean)
+#define AS_NUMBER(value) ((value).as.number)
+#define AS_OBJ(value) ((value).as.obj)
+
+#define IS_BOOL(value) ((value).type == VAL_BOOL)
+#define IS_NIL(value) ((value).type == VAL_NIL)
+#define IS_UNDEFINED(value) ((value).type == VAL_UNDEFINED)
+#define IS_NUMBER(value) ((value).type == VAL_NUMBER)
+#define IS_OBJ(value) ((value).type == VAL_OBJ)
+
+#endif
+
+bool valuesEqual(Value a, Value b);
+
+// value array
+
+typedef struct {
+  int capacity;
+  int count;
+  Value* values;
+} ValueArray;
+
+void initValueArray(ValueArray* array);
+ValueArray* newValueArray();
+void printValue(Value value);
+void writeValueArray(ValueArray* array, Value value);
+void freeValueArray(ValueArray* array);
+
+// stack
+
+typedef struct {
+  Value* top;
+  size_t size;
+  Value* values;
+} ValueStack;
+
+void initValueStack(ValueStack* stack, size_t size);
+void freeValueStack(ValueStack* stack);
+Value popValue(ValueStack* stack);
+void pushValue(ValueStack* stack, Value value);
+void printValueStack(ValueStack* stack);
+
 #endif
\ No newline at end of file
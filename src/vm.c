@@ -1,445 +1,1606 @@
-#include "vm.h"
-
-#include <stdarg.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-#include "common.h"
-#include "compiler.h"
-#include "debug.h"
-#include "memory.h"
-#include "object.h"
-#include "table.h"
-#include "value.h"
-
-static void push(Value val) { pushValue(&vm.stack, val); }
-
-static Value pop() { return popValue(&vm.stack); }
-
-static Value peek(size_t distance) { return vm.stack.top[-1 - distance]; }
-
-void printStack() {
-  // printValueStack(&vm.stack);
-  printf(" (%d)\n\n", (int)(vm.stack.top - vm.stack.values));
-}
-
-static Value clockNative(int argCount, Value* args) {
-  return NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
-}
-
-static void runtimeError(const char* format, ...) {
-  va_list args;
-  va_start(args, format);
-  vfprintf(stderr, format, args);
-  va_end(args);
-  fputs("\n", stderr);
-
-  for (int i = vm.frameCount - 1; i >= 0; i--) {
-    CallFrame* frame = &vm.frames[i];
-    ObjFunction* function = frame->closure->function;
-    // -1 because the IP is sitting on the next instruction to be
-    // executed.
-    size_t instruction = frame->ip - function->chunk.code - 1;
-    fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
-    if (function->name == NULL) {
-      fprintf(stderr, "script\n");
-    } else {
-      fprintf(stderr, "%s()\n", function->name->chars);
-    }
-  }
-
-  initValueStack(&vm.stack, STACK_SIZE);
-}
-
-static void defineNative(const char* name, NativeFn function) {
-  push(OBJ_VAL(copyString(name, (int)strlen(name))));
-  push(OBJ_VAL(newNative(function)));
-  tableSet(&vm.globals, AS_STRING(vm.stack.values[0]), vm.stack.values[1]);
-  pop();
-  pop();
-}
-
-void initVM() {
-  initValueStack(&vm.stack, STACK_SIZE);
-  initTable(&vm.strings);
-  initTable(&vm.globals);
-  vm.objects = NULL;
-  vm.frameCount = 0;
-  vm.openUpvalues = NULL;
-
-  vm.grayCapacity = 0;
-  vm.grayCount = 0;
-  vm.grayStack = NULL;
-
-  defineNative("clock", clockNative);
-}
-
-void freeVM() {
-  freeValueStack(&vm.stack);
-  freeTable(&vm.strings);
-  freeTable(&vm.globals);
-  freeObjects();
-  free(vm.grayStack);
-}
-
-static bool isFalsey(Value value) {
-  // a value is falsy if it's either nil or
-  // if it's a boolean and it's value is 'false'
-  return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
-}
-
-static void concatenate() {
-  ObjString* b = AS_STRING(pop());
-  ObjString* a = AS_STRING(pop());
-  int len = b->length + a->length;
-  ObjString* result = xallocateString(len);
-
-  for (int i = 0; i < a->length; i++) {
-    result->chars[i] = a->chars[i];
-  }
-
-  for (int i = 0; i < b->length; i++) {
-    result->chars[a->length + i] = b->chars[i];
-  }
-
-  result = validateString(result);
-  push(OBJ_VAL(result));
-}
-
-static bool call(ObjClosure* closure, int argCount) {
-  if (argCount != closure->function->arity) {
-    runtimeError("Expected %d arguments but got %d.", closure->function->arity,
-                 argCount);
-    return false;
-  }
-
-  if (vm.frameCount == FRAMES_MAX) {
-    runtimeError("Stack overflow.");
-    return false;
-  }
-
-  CallFrame* frame = &vm.frames[vm.frameCount++];
-  frame->closure = closure;
-  frame->ip = closure->function->chunk.code;
-
-  frame->slots = vm.stack.top - argCount - 1;
-
-  return true;
-}
-
-static bool callValue(Value callee, int argCount) {
-  if (IS_OBJ(callee)) {
-    switch (OBJ_TYPE(callee)) {
-    case OBJ_CLOSURE:
-      return call(AS_CLOSURE(callee), argCount);
-
-    case OBJ_NATIVE:
-      NativeFn native = AS_NATIVE(callee);
-      Value result = native(argCount, vm.stack.top - argCount);
-      vm.stack.top -= argCount + 1;
-      push(result);
-      return true;
-    default:
-      // Non-callable object type.
-      break;
-    }
-  }
-
-  runtimeError("Can only call functions and classes.");
-  return false;
-}
-
-static ObjUpvalue* captureValue(Value* local) {
-  ObjUpvalue* prev = NULL;
-  ObjUpvalue* current = vm.openUpvalues;
-
-  while (current != NULL && current->slot > local) {
-    prev = current;
-    current = current->next;
-  }
-  // if the upvalue has already been captured, return
-  // it.
-  if (current != NULL && current->slot == local) {
-    return current;
-  }
-
-  ObjUpvalue* createdUpvalue = newUpvalue(local);
-  createdUpvalue->next = current;
-
-  if (prev == NULL) {
-    vm.openUpvalues = createdUpvalue;
-  } else {
-    prev->next = createdUpvalue;
-  }
-
-  return createdUpvalue;
-}
-
-static void closeUpvalues(Value* last) {
-  while (vm.openUpvalues != NULL && vm.openUpvalues->slot >= last) {
-    ObjUpvalue* upval = vm.openUpvalues;
-    upval->closed = *upval->slot;
-    upval->slot = &upval->closed;
-    vm.openUpvalues = upval->next;
-  }
-}
-
-static InterpretResult run() {
-#define BINARY_OP(valueType, op)                                               \
-  do {                                                                         \
-    if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) {                          \
-      runtimeError("Operands must be numbers.");                               \
-      return INTERPRET_RUNTIME_ERROR;                                          \
-    }                                                                          \
-    double b = AS_NUMBER(pop());                                               \
-    double a = AS_NUMBER(pop());                                               \
-    push(valueType(a op b));                                                   \
-  } while (false)
-
-  CallFrame* frame = &vm.frames[vm.frameCount - 1];
-
-#define READ_BYTE() (*(frame->ip++))
-#define READ_CONSTANT()                                                        \
-  (frame->closure->function->chunk.constants.values[READ_BYTE()])
-#define READ_STRING() (AS_STRING(READ_CONSTANT()))
-#define READ_SHORT()                                                           \
-  (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | (frame->ip[-1])))
-  while (true) {
-#ifdef DEBUG_TRACE_EXECTUION
-    printStack();
-    disassembleInstruction(
-        &frame->closure->function->chunk,
-        (int)(frame->ip - frame->closure->function->chunk.code));
-#endif
-    uint8_t instruction = READ_BYTE();
-    Value valA, valB;
-    switch (instruction) {
-    case OP_RETURN: {
-      Value result = pop();
-      closeUpvalues(frame->slots);
-      vm.frameCount--;
-
-      if (vm.frameCount == 0) {
-        pop();
-        return INTERPRET_OK;
-      }
-
-      vm.stack.top = frame->slots;
-      push(result);
-
-      frame = &vm.frames[vm.frameCount - 1];
-      break;
-    }
-    case OP_CONSTANT: {
-      Value constant = READ_CONSTANT();
-      push(constant);
-      break;
-    }
-    case OP_NEGATE:
-      if (!IS_NUMBER(peek(0))) {
-        runtimeError("Operand must be a number.");
-        return INTERPRET_RUNTIME_ERROR;
-      }
-      push(NUMBER_VAL(-AS_NUMBER(pop())));
-      break;
-    case OP_MULT:
-      BINARY_OP(NUMBER_VAL, *);
-      break;
-    case OP_ADD:
-      if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-        concatenate();
-      } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
-        double b = AS_NUMBER(pop());
-        double a = AS_NUMBER(pop());
-        push(NUMBER_VAL(a + b));
-      } else {
-        runtimeError("Operands must be two numbers or two strings.");
-        return INTERPRET_RUNTIME_ERROR;
-      }
-      break;
-    case OP_SUB:
-      BINARY_OP(NUMBER_VAL, -);
-      break;
-    case OP_DIV:
-      BINARY_OP(NUMBER_VAL, /);
-      break;
-    case OP_NIL:
-      push(NIL_VAL);
-      break;
-    // having OP_TRUE
-    // and OP_FALSE is cheaper
-    // than storing them as value structs
-    // in the chunk's constant pool.
-    case OP_TRUE:
-      push(BOOL_VAL(true));
-      break;
-    case OP_FALSE:
-      push(BOOL_VAL(false));
-      break;
-    case OP_GREATER:
-      BINARY_OP(BOOL_VAL, >);
-      break;
-    case OP_LESS:
-      BINARY_OP(BOOL_VAL, <);
-      break;
-    case OP_EQUAL:
-      valA = pop();
-      valB = pop();
-      push(BOOL_VAL(valuesEqual(valA, valB)));
-      break;
-    case OP_NOT:
-      push(BOOL_VAL(isFalsey(pop())));
-      break;
-    case OP_PRINT:
-      printValue(pop());
-      printf("\n");
-      break;
-    case OP_POP:
-      pop();
-      break;
-    case OP_POPN: {
-      uint8_t count = READ_BYTE();
-      while (count--)
-        pop();
-      break;
-    }
-    case OP_DEFINE_GLOBAL: {
-      // peek becausesomething something garbage collection
-      ObjString* name = READ_STRING();
-      tableSet(&vm.globals, name, peek(0));
-      pop();
-      break;
-    }
-
-    case OP_GET_GLOBAL: {
-      ObjString* name = READ_STRING();
-      Value value;
-      if (!tableGet(&vm.globals, name, &value)) {
-        runtimeError("Undefined global '%s'.", name->chars);
-        return INTERPRET_RUNTIME_ERROR;
-      }
-      push(value);
-      break;
-    }
-
-    case OP_SET_GLOBAL: {
-      ObjString* name = READ_STRING();
-      // if the hash table doesn't already have a string
-      // going by that name then it creates a new key
-      // and then retruns true (isNewKey). Then we know
-      // that the global wasn't already defined and throw an
-      // error
-      if (tableSet(&vm.globals, name, peek(0))) {
-        tableDelete(&vm.globals, name);
-        runtimeError("Undefined variable '%s'.", name->chars);
-        return INTERPRET_RUNTIME_ERROR;
-      }
-      break;
-    }
-
-    case OP_GET_LOCAL: {
-      uint8_t slot = READ_BYTE();
-      push(frame->slots[slot]);
-      break;
-    }
-
-    case OP_SET_LOCAL: {
-      uint8_t slot = READ_BYTE();
-      frame->slots[slot] = peek(0);
-      break;
-    }
-
-    case OP_GET_UPVALUE: {
-      uint8_t index = READ_BYTE();
-      ObjUpvalue* upval = frame->closure->upvalues[index];
-      push(*frame->closure->upvalues[index]->slot);
-      break;
-    }
-
-    case OP_SET_UPVALUE: {
-      uint8_t index = READ_BYTE();
-      *frame->closure->upvalues[index]->slot = peek(0);
-      break;
-    }
-
-    case OP_JUMPZ: {
-      uint16_t offset = READ_SHORT();
-      if (isFalsey(peek(0)))
-        frame->ip += offset;
-      break;
-    }
-
-    case OP_JUMP: {
-      uint16_t offset = READ_SHORT();
-      frame->ip += offset;
-      break;
-    }
-
-    case OP_LOOP: {
-      uint16_t offset = READ_SHORT();
-      frame->ip -= offset;
-      break;
-    }
-
-    case OP_CALL: {
-      int argCount = READ_BYTE();
-
-      if (!callValue(peek(argCount), argCount)) {
-        return INTERPRET_RUNTIME_ERROR;
-      }
-      frame = &vm.frames[vm.frameCount - 1];
-      break;
-    }
-
-    case OP_CLOSURE: {
-      ObjFunction* function = AS_FUNCTION(READ_CONSTANT());
-      ObjClosure* closure = newClosure(function);
-      push(OBJ_VAL(closure));
-      for (int i = 0; i < closure->upvalueCount; i++) {
-        uint8_t isLocal = READ_BYTE();
-        uint8_t index = READ_BYTE();
-        if (isLocal) {
-          closure->upvalues[i] = captureValue(frame->slots + index);
-        } else {
-          closure->upvalues[i] = frame->closure->upvalues[i];
-        }
-      }
-      break;
-    }
-
-    case OP_CLOSE_UPVALUE: {
-      closeUpvalues(vm.stack.top - 1);
-      pop();
-      break;
-    }
-    }
-  }
-
-#undef READ_CONSTANT
-#undef READ_BYTE
-#undef READ_STRING
-#undef READ_SHORT
-#undef BINARY_OP
-}
-
-InterpretResult interpret(const char* source) {
-  Chunk chunk;
-  initChunk(&chunk);
-
-  // the compiler puts all the bytecode
-  // into the chunk's opcode array
-  ObjFunction* function = compile(source);
-
-  if (function == NULL)
-    return INTERPRET_COMPILE_ERROR;
-  push(OBJ_VAL(function));
-  ObjClosure* closure = newClosure(function);
-  pop();
-  push(OBJ_VAL(closure));
-  callValue(OBJ_VAL(closure), 0);
-
-  return run();
+#include "vm.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "compiler.h"
+#include "debug.h"
+#include "memory.h"
+#include "object.h"
+#include "profiler.h"
+#include "table.h"
+#include "value.h"
+
+// one isolate per thread: all VM state is thread-local, so independent
+// interpreters (each with its own heap, GC, and intern table) can run
+// on separate threads in one process without any locking.
+_Thread_local VM vm;
+
+static void push(Value val) { pushValue(&vm.stack, val); }
+
+static Value pop() { return popValue(&vm.stack); }
+
+static Value peek(size_t distance) { return vm.stack.top[-1 - distance]; }
+
+void printStack() {
+  // printValueStack(&vm.stack);
+  printf(" (%d)\n\n", (int)(vm.stack.top - vm.stack.values));
+}
+
+static Value clockNative(int argCount, Value* args) {
+  return NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+}
+
+// reports heap and collector statistics, and returns the number of
+// live bytes so scripts can track it over time.
+static Value gcstatsNative(int argCount, Value* args) {
+  printf("[gc] %zu bytes live, next collection at %zu bytes\n",
+         vm.bytesAllocated, vm.nextGC);
+  printf("[gc] %d major + %d minor collections, %.3f ms total pause, "
+         "%.3f ms last pause\n",
+         vm.gcCount, vm.gcMinorCount, vm.gcTotalPauseMs, vm.gcLastPauseMs);
+  return NUMBER_VAL((double)vm.bytesAllocated);
+}
+
+// length of an array or string-like value; nil for anything else.
+static Value lenNative(int argCount, Value* args) {
+  if (argCount != 1)
+    return NIL_VAL;
+  if (IS_ARRAY(args[0]))
+    return NUMBER_VAL((double)AS_ARRAY(args[0])->elements.count);
+  if (IS_STRING(args[0]))
+    return NUMBER_VAL((double)AS_STRING(args[0])->length);
+  if (IS_ROPE(args[0]))
+    return NUMBER_VAL((double)AS_ROPE(args[0])->length);
+  return NIL_VAL;
+}
+
+// appends a value to an array and returns the array. Both arguments
+// live on the VM stack, so they stay rooted if the growth collects.
+static Value pushNative(int argCount, Value* args) {
+  if (argCount != 2 || !IS_ARRAY(args[0]))
+    return NIL_VAL;
+  writeValueArray(&AS_ARRAY(args[0])->elements, args[1]);
+  gcWriteBarrier(AS_OBJ(args[0]), args[1]);
+  return args[0];
+}
+
+/*
+  Batch numeric natives: sum/scale/dot/min/max over arrays. Scoring
+  scripts reduce over tens of thousands of numbers, and doing that one
+  OP_INDEX_GET at a time pays interpreter dispatch per element; these
+  kernels stream the contiguous Value buffer instead. Under NaN boxing
+  an all-number array is bit-for-bit an array of doubles (numbers are
+  stored as their own bit pattern), so with SSE2 the kernels process
+  two lanes at a time. Arithmetic NaNs (0x7ff8...) don't collide with
+  the VM's tag space (0x7ffc...), so results can be stored back
+  verbatim.
+*/
+
+// the kernels require every element to be a number; one predictable
+// scan up front keeps the hot loops tag-free.
+static bool allNumbers(ValueArray* array) {
+  for (int i = 0; i < array->count; i++) {
+    if (!IS_NUMBER(array->values[i]))
+      return false;
+  }
+  return true;
+}
+
+#if defined(NAN_BOXING) && defined(__SSE2__)
+
+static double arraySum(ValueArray* array) {
+  const double* xs = (const double*)array->values;
+  __m128d acc = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 2 <= array->count; i += 2) {
+    acc = _mm_add_pd(acc, _mm_loadu_pd(xs + i));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double total = lanes[0] + lanes[1];
+  for (; i < array->count; i++) {
+    total += xs[i];
+  }
+  return total;
+}
+
+static void arrayScale(ValueArray* array, double factor) {
+  double* xs = (double*)array->values;
+  __m128d k = _mm_set1_pd(factor);
+  int i = 0;
+  for (; i + 2 <= array->count; i += 2) {
+    _mm_storeu_pd(xs + i, _mm_mul_pd(_mm_loadu_pd(xs + i), k));
+  }
+  for (; i < array->count; i++) {
+    xs[i] *= factor;
+  }
+}
+
+static double arrayDot(ValueArray* a, ValueArray* b) {
+  const double* xs = (const double*)a->values;
+  const double* ys = (const double*)b->values;
+  __m128d acc = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 2 <= a->count; i += 2) {
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(xs + i), _mm_loadu_pd(ys + i)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double total = lanes[0] + lanes[1];
+  for (; i < a->count; i++) {
+    total += xs[i] * ys[i];
+  }
+  return total;
+}
+
+// callers guarantee at least one element.
+static double arrayMin(ValueArray* array) {
+  const double* xs = (const double*)array->values;
+  __m128d acc = _mm_set1_pd(xs[0]);
+  int i = 0;
+  for (; i + 2 <= array->count; i += 2) {
+    acc = _mm_min_pd(acc, _mm_loadu_pd(xs + i));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double best = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+  for (; i < array->count; i++) {
+    if (xs[i] < best)
+      best = xs[i];
+  }
+  return best;
+}
+
+static double arrayMax(ValueArray* array) {
+  const double* xs = (const double*)array->values;
+  __m128d acc = _mm_set1_pd(xs[0]);
+  int i = 0;
+  for (; i + 2 <= array->count; i += 2) {
+    acc = _mm_max_pd(acc, _mm_loadu_pd(xs + i));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double best = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  for (; i < array->count; i++) {
+    if (xs[i] > best)
+      best = xs[i];
+  }
+  return best;
+}
+
+#else
+
+// scalar kernels for the tagged-union Value (or targets without SSE2);
+// still one tight loop per array instead of bytecode per element.
+
+static double arraySum(ValueArray* array) {
+  double total = 0.0;
+  for (int i = 0; i < array->count; i++) {
+    total += AS_NUMBER(array->values[i]);
+  }
+  return total;
+}
+
+static void arrayScale(ValueArray* array, double factor) {
+  for (int i = 0; i < array->count; i++) {
+    array->values[i] = NUMBER_VAL(AS_NUMBER(array->values[i]) * factor);
+  }
+}
+
+static double arrayDot(ValueArray* a, ValueArray* b) {
+  double total = 0.0;
+  for (int i = 0; i < a->count; i++) {
+    total += AS_NUMBER(a->values[i]) * AS_NUMBER(b->values[i]);
+  }
+  return total;
+}
+
+// callers guarantee at least one element.
+static double arrayMin(ValueArray* array) {
+  double best = AS_NUMBER(array->values[0]);
+  for (int i = 1; i < array->count; i++) {
+    double x = AS_NUMBER(array->values[i]);
+    if (x < best)
+      best = x;
+  }
+  return best;
+}
+
+static double arrayMax(ValueArray* array) {
+  double best = AS_NUMBER(array->values[0]);
+  for (int i = 1; i < array->count; i++) {
+    double x = AS_NUMBER(array->values[i]);
+    if (x > best)
+      best = x;
+  }
+  return best;
+}
+
+#endif
+
+// sum(a): adds up a numeric array (0 for an empty one); nil otherwise.
+static Value sumNative(int argCount, Value* args) {
+  if (argCount != 1 || !IS_ARRAY(args[0]))
+    return NIL_VAL;
+  ValueArray* elements = &AS_ARRAY(args[0])->elements;
+  if (!allNumbers(elements))
+    return NIL_VAL;
+  return NUMBER_VAL(arraySum(elements));
+}
+
+// scale(a, k): multiplies every element of a numeric array in place
+// and returns the array.
+static Value scaleNative(int argCount, Value* args) {
+  if (argCount != 2 || !IS_ARRAY(args[0]) || !IS_NUMBER(args[1]))
+    return NIL_VAL;
+  ValueArray* elements = &AS_ARRAY(args[0])->elements;
+  if (!allNumbers(elements))
+    return NIL_VAL;
+  arrayScale(elements, AS_NUMBER(args[1]));
+  return args[0];
+}
+
+// dot(a, b): inner product of two equal-length numeric arrays.
+static Value dotNative(int argCount, Value* args) {
+  if (argCount != 2 || !IS_ARRAY(args[0]) || !IS_ARRAY(args[1]))
+    return NIL_VAL;
+  ValueArray* a = &AS_ARRAY(args[0])->elements;
+  ValueArray* b = &AS_ARRAY(args[1])->elements;
+  if (a->count != b->count || !allNumbers(a) || !allNumbers(b))
+    return NIL_VAL;
+  return NUMBER_VAL(arrayDot(a, b));
+}
+
+// min(a) / max(a): smallest/largest element of a non-empty numeric
+// array.
+static Value minNative(int argCount, Value* args) {
+  if (argCount != 1 || !IS_ARRAY(args[0]))
+    return NIL_VAL;
+  ValueArray* elements = &AS_ARRAY(args[0])->elements;
+  if (elements->count == 0 || !allNumbers(elements))
+    return NIL_VAL;
+  return NUMBER_VAL(arrayMin(elements));
+}
+
+static Value maxNative(int argCount, Value* args) {
+  if (argCount != 1 || !IS_ARRAY(args[0]))
+    return NIL_VAL;
+  ValueArray* elements = &AS_ARRAY(args[0])->elements;
+  if (elements->count == 0 || !allNumbers(elements))
+    return NIL_VAL;
+  return NUMBER_VAL(arrayMax(elements));
+}
+
+static bool call(ObjClosure* closure, ObjFunction* function, int argCount);
+
+/*
+  Fibers: cooperatively scheduled Lox "threads" sharing one isolate.
+  fiber(fn) wraps a closure in an ObjFiber; resume(f, v) suspends the
+  caller and runs f until it calls yield(v) or returns, at which point
+  control comes back to the resumer with that value as resume's result.
+
+  The VM always executes out of vm.stack/vm.frames, so the interpreter
+  loop doesn't know fibers exist: a switch just parks those fields in
+  the outgoing fiber and loads the incoming one's. resume and yield
+  signal the switch to callValue by returning UNDEFINED_VAL (which
+  scripts can never produce), telling it to skip the usual pop-args-
+  push-result epilogue - each side's stack is left holding exactly what
+  the fiber expects to see when it next runs.
+*/
+
+// initial per-fiber stack; reserveFrameSlots grows it like the main one.
+#define FIBER_STACK_SIZE 64
+
+// parks the active execution state in `fiber`. Between here and the
+// matching fiberLoad the VM's frame array is mid-swap, so sampling is
+// paused for the duration.
+static void fiberSave(ObjFiber* fiber) {
+  samplePause();
+  fiber->stack = vm.stack;
+  fiber->frames = vm.frames;
+  fiber->frameCount = vm.frameCount;
+  fiber->openUpvalues = vm.openUpvalues;
+  // the parked stack can be full of young objects the VM roots no
+  // longer reach; an old fiber has to carry them through minor
+  // collections itself.
+  gcRemember((Obj*)fiber);
+}
+
+// makes `fiber` the running one. Its buffers change hands rather than
+// being copied, and the saved pointers are cleared so teardown never
+// sees (and frees) the same stack twice.
+static void fiberLoad(ObjFiber* fiber) {
+  vm.stack = fiber->stack;
+  vm.frames = fiber->frames;
+  vm.frameCount = fiber->frameCount;
+  vm.openUpvalues = fiber->openUpvalues;
+  fiber->stack.values = NULL;
+  fiber->stack.top = NULL;
+  fiber->stack.size = 0;
+  fiber->frames = NULL;
+  fiber->frameCount = 0;
+  fiber->openUpvalues = NULL;
+  fiber->state = FIBER_RUNNING;
+  vm.fiber = fiber;
+  sampleResume();
+}
+
+// wraps a function (or capturing closure) of arity 0 or 1 in a new,
+// not-yet-started fiber.
+static Value fiberNative(int argCount, Value* args) {
+  if (argCount != 1)
+    return NIL_VAL;
+  ObjClosure* closure = NULL;
+  ObjFunction* function = NULL;
+  if (IS_CLOSURE(args[0])) {
+    closure = AS_CLOSURE(args[0]);
+    function = closure->function;
+  } else if (IS_FUNCTION(args[0])) {
+    function = AS_FUNCTION(args[0]);
+  } else {
+    return NIL_VAL;
+  }
+  if (function->arity > 1)
+    return NIL_VAL;
+  return OBJ_VAL(newFiber(closure, function));
+}
+
+// true once a fiber's entry function has returned; schedulers poll
+// this to know when to stop resuming.
+static Value fiberDoneNative(int argCount, Value* args) {
+  if (argCount != 1 || !IS_FIBER(args[0]))
+    return NIL_VAL;
+  return BOOL_VAL(AS_FIBER(args[0])->state == FIBER_DONE);
+}
+
+// resume(f) / resume(f, v): suspend the calling fiber and run f. A
+// first resume passes v to f's entry function (if it takes a
+// parameter); later ones make v the result of the yield that suspended
+// f. Resuming a running or finished fiber is a no-op returning nil.
+static Value resumeNative(int argCount, Value* args) {
+  if (argCount < 1 || argCount > 2 || !IS_FIBER(args[0]))
+    return NIL_VAL;
+  ObjFiber* fiber = AS_FIBER(args[0]);
+  if (fiber->state != FIBER_NEW && fiber->state != FIBER_SUSPENDED)
+    return NIL_VAL;
+  Value value = argCount == 2 ? args[1] : NIL_VAL;
+
+  // adopt the main script into a fiber the first time one is resumed,
+  // so there is always somewhere to park the outgoing state. Every
+  // allocation below happens while the caller's stack (which roots the
+  // fiber and the value) is still fully intact.
+  if (vm.fiber == NULL) {
+    ObjFiber* root = newFiber(NULL, NULL);
+    root->state = FIBER_RUNNING;
+    vm.fiber = root;
+  }
+
+  bool firstRun = fiber->state == FIBER_NEW;
+  if (firstRun) {
+    initValueStack(&fiber->stack, FIBER_STACK_SIZE);
+    fiber->frames = ALLOCATE(CallFrame, FRAMES_MAX);
+    memset(fiber->frames, 0, sizeof(CallFrame) * FRAMES_MAX);
+  }
+
+  ObjFiber* caller = vm.fiber;
+  fiberSave(caller);
+  caller->state = FIBER_SUSPENDED;
+  fiber->caller = caller;
+  fiberLoad(fiber);
+
+  if (firstRun) {
+    // seed the new stack like a regular call site: callee, then the
+    // argument if the entry function declares one.
+    int arity = fiber->function->arity;
+    if (fiber->closure != NULL) {
+      push(OBJ_VAL(fiber->closure));
+    } else {
+      push(OBJ_VAL(fiber->function));
+    }
+    if (arity == 1)
+      push(value);
+    call(fiber->closure, fiber->function, arity);
+  } else {
+    // the result of the yield that suspended this fiber. Its stack
+    // freed at least one slot when the yield call was popped, so this
+    // push cannot grow (or collect).
+    push(value);
+  }
+
+  // drop the resume call off the caller's parked stack; the matching
+  // result is pushed there when this fiber yields or returns.
+  caller->stack.top -= argCount + 1;
+  return UNDEFINED_VAL;
+}
+
+// yield() / yield(v): suspend the calling fiber and hand v (or nil)
+// back to its resumer. Yielding outside a fiber is a no-op.
+static Value yieldNative(int argCount, Value* args) {
+  if (argCount > 1)
+    return NIL_VAL;
+  if (vm.fiber == NULL || vm.fiber->caller == NULL)
+    return NIL_VAL;
+  Value value = argCount == 1 ? args[0] : NIL_VAL;
+
+  ObjFiber* fiber = vm.fiber;
+  ObjFiber* caller = fiber->caller;
+  fiber->caller = NULL;
+  fiberSave(fiber);
+  fiber->state = FIBER_SUSPENDED;
+  // pop the yield call; the next resume pushes its value here.
+  fiber->stack.top -= argCount + 1;
+  fiberLoad(caller);
+  // the resumer's stack freed the resume call's slots when it
+  // suspended, so this push cannot grow (or collect).
+  push(value);
+  return UNDEFINED_VAL;
+}
+
+static void runtimeError(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputs("\n", stderr);
+
+  for (int i = vm.frameCount - 1; i >= 0; i--) {
+    CallFrame* frame = &vm.frames[i];
+    ObjFunction* function = frame->function;
+    // -1 because the IP is sitting on the next instruction to be
+    // executed.
+    size_t instruction = frame->ip - function->chunk.code - 1;
+    fprintf(stderr, "[line %d] in ", getLine(&function->chunk, instruction));
+    if (function->name == NULL) {
+      fprintf(stderr, "script\n");
+    } else {
+      fprintf(stderr, "%s()\n", function->name->chars);
+    }
+  }
+
+  // rewind rather than reallocate: a fresh allocation would leak the
+  // old array and can itself trigger a collection while vm.stack is
+  // half-initialized.
+  vm.stack.top = vm.stack.values;
+}
+
+int globalSlot(ObjString* name) {
+  Value slot;
+  if (tableGet(&vm.globalNames, name, &slot)) {
+    return (int)AS_NUMBER(slot);
+  }
+
+  int index = vm.globalSlots.count;
+  if (index > UINT8_MAX)
+    return -1;
+
+  // keep the name rooted while growing the tables below.
+  push(OBJ_VAL(name));
+  writeValueArray(&vm.globalSlots, UNDEFINED_VAL);
+  tableSet(&vm.globalNames, name, NUMBER_VAL(index));
+  pop();
+  return index;
+}
+
+// slow path for error messages only: recover a slot's name from the
+// name -> slot table.
+static ObjString* globalSlotName(int slot) {
+  for (int i = 0; i < vm.globalNames.cap; i++) {
+    Entry* entry = &vm.globalNames.entries[i];
+    if (entry->key != NULL && (int)AS_NUMBER(entry->value) == slot) {
+      return entry->key;
+    }
+  }
+  return NULL;
+}
+
+static void defineNative(const char* name, NativeFn function) {
+  push(OBJ_VAL(copyString(name, (int)strlen(name))));
+  push(OBJ_VAL(newNative(function)));
+  tableSet(&vm.globals, AS_STRING(vm.stack.values[0]), vm.stack.values[1]);
+  // natives get a slot too, so scripts reach them with one array load.
+  int slot = globalSlot(AS_STRING(vm.stack.values[0]));
+  if (slot != -1) {
+    vm.globalSlots.values[slot] = vm.stack.values[1];
+  }
+  pop();
+  pop();
+}
+
+void initVM() {
+  vm.objects = NULL;
+  vm.youngObjects = NULL;
+  vm.frameCount = 0;
+  vm.openUpvalues = NULL;
+  vm.fiber = NULL;
+
+  vm.grayCapacity = 0;
+  vm.grayCount = 0;
+  vm.grayStack = NULL;
+
+  vm.remembered = NULL;
+  vm.rememberedCount = 0;
+  vm.rememberedCapacity = 0;
+  vm.gcMinor = false;
+
+  vm.bytesAllocated = 0;
+  vm.youngBytes = 0;
+  vm.nextGC = 1024 * 1024;
+  vm.gcCount = 0;
+  vm.gcMinorCount = 0;
+  vm.gcLastPauseMs = 0;
+  vm.gcTotalPauseMs = 0;
+
+  initValueStack(&vm.stack, STACK_SIZE);
+  vm.frames = ALLOCATE(CallFrame, FRAMES_MAX);
+  // zeroed so the sampler never sees garbage in not-yet-used slots.
+  memset(vm.frames, 0, sizeof(CallFrame) * FRAMES_MAX);
+  initTable(&vm.strings);
+  initTable(&vm.globals);
+  initTable(&vm.globalNames);
+  initValueArray(&vm.globalSlots);
+  initTable(&vm.replCache);
+
+  defineNative("clock", clockNative);
+  defineNative("gcstats", gcstatsNative);
+  defineNative("len", lenNative);
+  defineNative("push", pushNative);
+  defineNative("sum", sumNative);
+  defineNative("scale", scaleNative);
+  defineNative("dot", dotNative);
+  defineNative("min", minNative);
+  defineNative("max", maxNative);
+  defineNative("fiber", fiberNative);
+  defineNative("resume", resumeNative);
+  defineNative("yield", yieldNative);
+  defineNative("fiberDone", fiberDoneNative);
+}
+
+void freeVM() {
+  // before freeObjects: the reports walk the live function objects.
+  profileDump();
+  sampleDump();
+  freeValueStack(&vm.stack);
+  // any parked fiber stacks are freed with their objects below.
+  FREE_ARRAY(vm.frames, CallFrame, FRAMES_MAX);
+  freeTable(&vm.strings);
+  freeTable(&vm.globals);
+  freeTable(&vm.globalNames);
+  freeValueArray(&vm.globalSlots);
+  freeTable(&vm.replCache);
+  freeObjects();
+  freePools();
+  free(vm.grayStack);
+  free(vm.remembered);
+}
+
+static bool isFalsey(Value value) {
+  // a value is falsy if it's either nil or
+  // if it's a boolean and it's value is 'false'
+  return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
+}
+
+static void concatenate() {
+  // the operands stay on the stack (rooted) until the rope node is
+  // allocated, since the allocation may trigger a collection.
+  ObjRope* rope = newRope(AS_OBJ(peek(1)), AS_OBJ(peek(0)));
+  pop();
+  pop();
+  push(OBJ_VAL(rope));
+}
+
+// makes sure the frame whose window starts `slotsOffset` values into
+// the stack can address `maxStack` slots, so no push inside it ever
+// needs a bounds check. If the stack has to grow, every live pointer
+// into the old array - the top, each frame's slot window, and open
+// upvalue slots - is rebased onto the new one; callers holding raw
+// Value* of their own must recompute them afterwards.
+static void reserveFrameSlots(size_t slotsOffset, int maxStack) {
+  size_t needed = slotsOffset + (size_t)maxStack;
+  if (needed <= vm.stack.size)
+    return;
+
+  Value* oldBase = vm.stack.values;
+  size_t oldSize = vm.stack.size;
+  size_t newSize = oldSize;
+  while (newSize < needed)
+    newSize = GROW_CAPACITY(newSize);
+  vm.stack.values = GROW_ARRAY(vm.stack.values, Value, oldSize, newSize);
+  vm.stack.size = newSize;
+
+  if (vm.stack.values != oldBase) {
+    ptrdiff_t delta = vm.stack.values - oldBase;
+    vm.stack.top += delta;
+    for (int i = 0; i < vm.frameCount; i++) {
+      vm.frames[i].slots += delta;
+    }
+    for (ObjUpvalue* upval = vm.openUpvalues; upval != NULL;
+         upval = upval->next) {
+      upval->slot += delta;
+    }
+  }
+}
+
+// `closure` is NULL when a zero-upvalue function is called directly;
+// `function` is always the code being entered.
+static bool call(ObjClosure* closure, ObjFunction* function, int argCount) {
+  if (argCount != function->arity) {
+    runtimeError("Expected %d arguments but got %d.", function->arity,
+                 argCount);
+    return false;
+  }
+
+  if (vm.frameCount == FRAMES_MAX) {
+    runtimeError("Stack overflow.");
+    return false;
+  }
+
+  reserveFrameSlots((size_t)(vm.stack.top - vm.stack.values) - argCount - 1,
+                    function->maxStack);
+
+  // fill the frame before publishing it: the sampler walks frames up
+  // to frameCount from a signal handler, so the increment comes last.
+  CallFrame* frame = &vm.frames[vm.frameCount];
+  frame->closure = closure;
+  frame->function = function;
+  frame->ip = function->chunk.code;
+
+  frame->slots = vm.stack.top - argCount - 1;
+  SAMPLE_FENCE();
+  vm.frameCount++;
+
+  if (profileEnabled)
+    profileCall(function);
+
+  return true;
+}
+
+static bool callValue(Value callee, int argCount) {
+  if (IS_OBJ(callee)) {
+    switch (OBJ_TYPE(callee)) {
+    case OBJ_CLOSURE:
+      return call(AS_CLOSURE(callee), AS_CLOSURE(callee)->function, argCount);
+
+    // a bare function: the compiler elided its closure because it
+    // captures nothing.
+    case OBJ_FUNCTION:
+      return call(NULL, AS_FUNCTION(callee), argCount);
+
+    case OBJ_NATIVE:
+      NativeFn native = AS_NATIVE(callee);
+      Value result = native(argCount, vm.stack.top - argCount);
+      // the fiber natives switch the active stack themselves and
+      // signal it with UNDEFINED_VAL (unproducible from scripts):
+      // both stacks are already arranged, so skip the epilogue.
+      if (IS_UNDEFINED(result))
+        return true;
+      vm.stack.top -= argCount + 1;
+      push(result);
+      return true;
+    default:
+      // Non-callable object type.
+      break;
+    }
+  }
+
+  runtimeError("Can only call functions and classes.");
+  return false;
+}
+
+static ObjUpvalue* captureValue(Value* local) {
+  ObjUpvalue* prev = NULL;
+  ObjUpvalue* current = vm.openUpvalues;
+
+  while (current != NULL && current->slot > local) {
+    prev = current;
+    current = current->next;
+  }
+  // if the upvalue has already been captured, return
+  // it.
+  if (current != NULL && current->slot == local) {
+    return current;
+  }
+
+  ObjUpvalue* createdUpvalue = newUpvalue(local);
+  createdUpvalue->next = current;
+
+  if (prev == NULL) {
+    vm.openUpvalues = createdUpvalue;
+  } else {
+    prev->next = createdUpvalue;
+  }
+
+  return createdUpvalue;
+}
+
+static void closeUpvalues(Value* last) {
+  while (vm.openUpvalues != NULL && vm.openUpvalues->slot >= last) {
+    ObjUpvalue* upval = vm.openUpvalues;
+    upval->closed = *upval->slot;
+    upval->slot = &upval->closed;
+    // an upvalue that survived a collection while open can close over
+    // a value younger than itself.
+    gcWriteBarrier((Obj*)upval, upval->closed);
+    vm.openUpvalues = upval->next;
+  }
+}
+
+static InterpretResult run() {
+  CallFrame* frame = &vm.frames[vm.frameCount - 1];
+
+  // the stack-top pointer lives in a local (register) for the whole
+  // interpreter loop instead of being loaded and stored through
+  // vm.stack.top on every operand. The values themselves still go to
+  // stack memory, so the GC always sees current operands - but the GC
+  // (and anything else outside run()) reads vm.stack.top, so the local
+  // is written back with SAVE_STACK() before any call that can
+  // allocate, run a native, or report an error, and re-read with
+  // RESTORE_STACK() after calls that push or pop themselves.
+  register Value* stackTop = vm.stack.top;
+
+#define SAVE_STACK() (vm.stack.top = stackTop)
+#define RESTORE_STACK() (stackTop = vm.stack.top)
+// unchecked on purpose: reserveFrameSlots guarantees at call time that
+// the running frame can reach its compile-time maximum depth, so a
+// push is a single store.
+#define PUSH(value) (*stackTop++ = (value))
+#define POP() (*(--stackTop))
+#define PEEK(distance) (stackTop[-1 - (distance)])
+
+// one operand is popped, the other is combined into it in place, so a
+// binary op costs one load and one store of stack memory instead of
+// two of each plus the pointer traffic.
+#define BINARY_OP(valueType, op)                                               \
+  do {                                                                         \
+    if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {                          \
+      SAVE_STACK();                                                            \
+      runtimeError("Operands must be numbers.");                               \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+    double b = AS_NUMBER(POP());                                               \
+    stackTop[-1] = valueType(AS_NUMBER(stackTop[-1]) op b);                    \
+  } while (false)
+
+#define READ_BYTE() (*(frame->ip++))
+#define READ_CONSTANT()                                                        \
+  (frame->function->chunk.constants.values[READ_BYTE()])
+#define READ_STRING() (AS_STRING(READ_CONSTANT()))
+#define READ_CONSTANT_LONG()                                                   \
+  (frame->function->chunk.constants                                   \
+       .values[(frame->ip += 2,                                                \
+                (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))])
+#define READ_STRING_LONG() (AS_STRING(READ_CONSTANT_LONG()))
+#define READ_SHORT()                                                           \
+  (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | (frame->ip[-1])))
+
+#ifdef DEBUG_TRACE_EXECTUION
+#define TRACE_EXECUTION()                                                      \
+  do {                                                                         \
+    SAVE_STACK();                                                              \
+    printStack();                                                              \
+    disassembleInstruction(                                                    \
+        &frame->function->chunk,                                      \
+        (int)(frame->ip - frame->function->chunk.code));              \
+  } while (false)
+#else
+#define TRACE_EXECUTION()                                                      \
+  do {                                                                         \
+  } while (false)
+#endif
+
+// With threaded dispatch every opcode handler ends in its own
+// indirect "goto", so the branch predictor can learn which opcode
+// tends to follow which, instead of mispredicting through the single
+// branch of a switch. Falls back to the plain switch on compilers
+// without the labels-as-values extension.
+#ifdef CLOX_THREADED_DISPATCH
+  static void* dispatchTable[] = {
+      [OP_RETURN] = &&code_OP_RETURN,
+      [OP_CONSTANT] = &&code_OP_CONSTANT,
+      [OP_NIL] = &&code_OP_NIL,
+      [OP_NOT] = &&code_OP_NOT,
+      [OP_TRUE] = &&code_OP_TRUE,
+      [OP_FALSE] = &&code_OP_FALSE,
+      [OP_EQUAL] = &&code_OP_EQUAL,
+      [OP_LESS] = &&code_OP_LESS,
+      [OP_GREATER] = &&code_OP_GREATER,
+      [OP_NEGATE] = &&code_OP_NEGATE,
+      [OP_MULT] = &&code_OP_MULT,
+      [OP_DIV] = &&code_OP_DIV,
+      [OP_ADD] = &&code_OP_ADD,
+      [OP_SUB] = &&code_OP_SUB,
+      [OP_PRINT] = &&code_OP_PRINT,
+      [OP_POP] = &&code_OP_POP,
+      [OP_POPN] = &&code_OP_POPN,
+      [OP_DEFINE_GLOBAL] = &&code_OP_DEFINE_GLOBAL,
+      [OP_GET_GLOBAL] = &&code_OP_GET_GLOBAL,
+      [OP_SET_GLOBAL] = &&code_OP_SET_GLOBAL,
+      [OP_SET_LOCAL] = &&code_OP_SET_LOCAL,
+      [OP_GET_LOCAL] = &&code_OP_GET_LOCAL,
+      [OP_JUMPZ] = &&code_OP_JUMPZ,
+      [OP_JUMP] = &&code_OP_JUMP,
+      [OP_LOOP] = &&code_OP_LOOP,
+      [OP_CALL] = &&code_OP_CALL,
+      [OP_CLOSURE] = &&code_OP_CLOSURE,
+      [OP_GET_UPVALUE] = &&code_OP_GET_UPVALUE,
+      [OP_SET_UPVALUE] = &&code_OP_SET_UPVALUE,
+      [OP_CLOSE_UPVALUE] = &&code_OP_CLOSE_UPVALUE,
+      [OP_DEFINE_GLOBAL_SLOT] = &&code_OP_DEFINE_GLOBAL_SLOT,
+      [OP_GET_GLOBAL_SLOT] = &&code_OP_GET_GLOBAL_SLOT,
+      [OP_SET_GLOBAL_SLOT] = &&code_OP_SET_GLOBAL_SLOT,
+      [OP_NOT_EQUAL] = &&code_OP_NOT_EQUAL,
+      [OP_GREATER_EQUAL] = &&code_OP_GREATER_EQUAL,
+      [OP_LESS_EQUAL] = &&code_OP_LESS_EQUAL,
+      [OP_ADD_CONST] = &&code_OP_ADD_CONST,
+      [OP_TAIL_CALL] = &&code_OP_TAIL_CALL,
+      [OP_ARRAY] = &&code_OP_ARRAY,
+      [OP_INDEX_GET] = &&code_OP_INDEX_GET,
+      [OP_INDEX_SET] = &&code_OP_INDEX_SET,
+      [OP_CONSTANT_LONG] = &&code_OP_CONSTANT_LONG,
+      [OP_DEFINE_GLOBAL_LONG] = &&code_OP_DEFINE_GLOBAL_LONG,
+      [OP_GET_GLOBAL_LONG] = &&code_OP_GET_GLOBAL_LONG,
+      [OP_SET_GLOBAL_LONG] = &&code_OP_SET_GLOBAL_LONG,
+      [OP_ADD_NUM] = &&code_OP_ADD_NUM,
+      [OP_ADD_STR] = &&code_OP_ADD_STR,
+      [OP_LESS_NUM] = &&code_OP_LESS_NUM,
+      [OP_GREATER_NUM] = &&code_OP_GREATER_NUM,
+      [OP_INLINE_GUARD] = &&code_OP_INLINE_GUARD,
+  };
+
+#define CASE_CODE(name) code_##name
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    TRACE_EXECUTION();                                                         \
+    instruction = READ_BYTE();                                                 \
+    PROFILE_OP(instruction);                                                   \
+    goto* dispatchTable[instruction];                                          \
+  } while (false)
+#define INTERPRET_LOOP DISPATCH();
+#else
+#define CASE_CODE(name) case name
+#define DISPATCH() goto loop
+#define INTERPRET_LOOP                                                         \
+  loop:                                                                        \
+  TRACE_EXECUTION();                                                           \
+  instruction = READ_BYTE();                                                   \
+  PROFILE_OP(instruction);                                                     \
+  switch (instruction)
+#endif
+
+  uint8_t instruction;
+
+  INTERPRET_LOOP {
+    CASE_CODE(OP_RETURN) : {
+      Value result = POP();
+      closeUpvalues(frame->slots);
+      vm.frameCount--;
+      if (profileEnabled)
+        profileReturn();
+
+      if (vm.frameCount == 0) {
+        POP();
+        SAVE_STACK();
+        if (vm.fiber != NULL && vm.fiber->caller != NULL) {
+          // a finishing fiber acts like a final yield of its return
+          // value: control goes back to the resumer for good.
+          ObjFiber* finished = vm.fiber;
+          ObjFiber* caller = finished->caller;
+          finished->caller = NULL;
+          fiberSave(finished);
+          finished->state = FIBER_DONE;
+          fiberLoad(caller);
+          // fits without growing: the resume call's slots were freed
+          // when the caller suspended.
+          push(result);
+          // the dead stack and frame window are reclaimed now instead
+          // of riding along until the fiber object is collected.
+          freeValueStack(&finished->stack);
+          finished->stack.values = NULL;
+          FREE_ARRAY(finished->frames, CallFrame, FRAMES_MAX);
+          finished->frames = NULL;
+          RESTORE_STACK();
+          frame = &vm.frames[vm.frameCount - 1];
+          DISPATCH();
+        }
+        return INTERPRET_OK;
+      }
+
+      stackTop = frame->slots;
+      PUSH(result);
+
+      frame = &vm.frames[vm.frameCount - 1];
+      DISPATCH();
+    }
+    CASE_CODE(OP_CONSTANT) : {
+      Value constant = READ_CONSTANT();
+      PUSH(constant);
+      DISPATCH();
+    }
+    CASE_CODE(OP_NEGATE) : {
+      if (!IS_NUMBER(PEEK(0))) {
+        SAVE_STACK();
+        runtimeError("Operand must be a number.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      stackTop[-1] = NUMBER_VAL(-AS_NUMBER(stackTop[-1]));
+      DISPATCH();
+    }
+    CASE_CODE(OP_MULT) : {
+      BINARY_OP(NUMBER_VAL, *);
+      DISPATCH();
+    }
+    // the generic arithmetic/comparison opcodes quicken: once a site
+    // observes its operand types it rewrites itself in place to the
+    // specialized variant, which skips the type dispatch and rewrites
+    // back (deopting) if the types ever change. Monomorphic sites -
+    // nearly all of them in practice - settle after one execution; a
+    // genuinely polymorphic site just pays one byte store per flip.
+    CASE_CODE(OP_ADD) : {
+      if (IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1))) {
+        frame->ip[-1] = OP_ADD_NUM;
+        double b = AS_NUMBER(POP());
+        stackTop[-1] = NUMBER_VAL(AS_NUMBER(stackTop[-1]) + b);
+      } else if (IS_STRINGLIKE(PEEK(0)) && IS_STRINGLIKE(PEEK(1))) {
+        frame->ip[-1] = OP_ADD_STR;
+        SAVE_STACK();
+        concatenate();
+        RESTORE_STACK();
+      } else {
+        SAVE_STACK();
+        runtimeError("Operands must be two numbers or two strings.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_ADD_NUM) : {
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+        // deopt: back up and let the generic handler re-dispatch (and
+        // re-quicken, or report the error).
+        frame->ip[-1] = OP_ADD;
+        frame->ip--;
+        DISPATCH();
+      }
+      double b = AS_NUMBER(POP());
+      stackTop[-1] = NUMBER_VAL(AS_NUMBER(stackTop[-1]) + b);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_ADD_STR) : {
+      if (!IS_STRINGLIKE(PEEK(0)) || !IS_STRINGLIKE(PEEK(1))) {
+        frame->ip[-1] = OP_ADD;
+        frame->ip--;
+        DISPATCH();
+      }
+      SAVE_STACK();
+      concatenate();
+      RESTORE_STACK();
+      DISPATCH();
+    }
+    CASE_CODE(OP_SUB) : {
+      BINARY_OP(NUMBER_VAL, -);
+      DISPATCH();
+    }
+    CASE_CODE(OP_DIV) : {
+      BINARY_OP(NUMBER_VAL, /);
+      DISPATCH();
+    }
+    CASE_CODE(OP_NIL) : {
+      PUSH(NIL_VAL);
+      DISPATCH();
+    }
+    // having OP_TRUE
+    // and OP_FALSE is cheaper
+    // than storing them as value structs
+    // in the chunk's constant pool.
+    CASE_CODE(OP_TRUE) : {
+      PUSH(BOOL_VAL(true));
+      DISPATCH();
+    }
+    CASE_CODE(OP_FALSE) : {
+      PUSH(BOOL_VAL(false));
+      DISPATCH();
+    }
+    CASE_CODE(OP_GREATER) : {
+      if (IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1)))
+        frame->ip[-1] = OP_GREATER_NUM;
+      BINARY_OP(BOOL_VAL, >);
+      DISPATCH();
+    }
+    CASE_CODE(OP_LESS) : {
+      if (IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1)))
+        frame->ip[-1] = OP_LESS_NUM;
+      BINARY_OP(BOOL_VAL, <);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GREATER_NUM) : {
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+        frame->ip[-1] = OP_GREATER;
+        frame->ip--;
+        DISPATCH();
+      }
+      double b = AS_NUMBER(POP());
+      stackTop[-1] = BOOL_VAL(AS_NUMBER(stackTop[-1]) > b);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_LESS_NUM) : {
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+        frame->ip[-1] = OP_LESS;
+        frame->ip--;
+        DISPATCH();
+      }
+      double b = AS_NUMBER(POP());
+      stackTop[-1] = BOOL_VAL(AS_NUMBER(stackTop[-1]) < b);
+      DISPATCH();
+    }
+    CASE_CODE(OP_INLINE_GUARD) : {
+      // the compiler's inlining bet: the value about to be called is
+      // still the function whose body was spliced in after this
+      // instruction's jump target. On a match the splice runs with the
+      // callee value standing in for frame slot 0; on a mismatch
+      // (reassignment, shadowing) control falls through to the real
+      // OP_CALL that follows.
+      uint8_t argCount = READ_BYTE();
+      Value expected = READ_CONSTANT();
+      uint16_t offset = READ_SHORT();
+      if (valuesEqual(PEEK(argCount), expected))
+        frame->ip += offset;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_EQUAL) : {
+      // compare before popping: equality may flatten a rope, which
+      // allocates, and the operands have to stay rooted through that.
+      SAVE_STACK();
+      bool equal = valuesEqual(PEEK(1), PEEK(0));
+      stackTop -= 2;
+      PUSH(BOOL_VAL(equal));
+      DISPATCH();
+    }
+    CASE_CODE(OP_NOT) : {
+      stackTop[-1] = BOOL_VAL(isFalsey(stackTop[-1]));
+      DISPATCH();
+    }
+    CASE_CODE(OP_PRINT) : {
+      // pop after printing: printing a rope flattens it, which
+      // allocates, so the value must stay rooted until then.
+      SAVE_STACK();
+      printValue(PEEK(0));
+      printf("\n");
+      stackTop--;
+      DISPATCH();
+    }
+    CASE_CODE(OP_POP) : {
+      stackTop--;
+      DISPATCH();
+    }
+    CASE_CODE(OP_POPN) : {
+      uint8_t count = READ_BYTE();
+      stackTop -= count;
+      DISPATCH();
+    }
+    CASE_CODE(OP_DEFINE_GLOBAL) : {
+      // peek becausesomething something garbage collection
+      ObjString* name = READ_STRING();
+      SAVE_STACK();
+      tableSet(&vm.globals, name, PEEK(0));
+      stackTop--;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GET_GLOBAL) : {
+      ObjString* name = READ_STRING();
+      uint16_t cacheIndex = READ_SHORT();
+      InlineCache* cache = &frame->function->chunk.caches[cacheIndex];
+
+      // fast path: the binding hasn't moved since this site last ran.
+      if (cache->tableCap == vm.globals.cap &&
+          vm.globals.entries[cache->tableIndex].key == name) {
+        PUSH(vm.globals.entries[cache->tableIndex].value);
+        DISPATCH();
+      }
+
+      Entry* entry = tableFindEntry(&vm.globals, name);
+      if (entry == NULL || entry->key == NULL) {
+        SAVE_STACK();
+        runtimeError("Undefined global '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      cache->tableCap = vm.globals.cap;
+      cache->tableIndex = (int)(entry - vm.globals.entries);
+      PUSH(entry->value);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_SET_GLOBAL) : {
+      ObjString* name = READ_STRING();
+      // if the hash table doesn't already have a string
+      // going by that name then it creates a new key
+      // and then retruns true (isNewKey). Then we know
+      // that the global wasn't already defined and throw an
+      // error
+      SAVE_STACK();
+      if (tableSet(&vm.globals, name, PEEK(0))) {
+        tableDelete(&vm.globals, name);
+        runtimeError("Undefined variable '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GET_LOCAL) : {
+      uint8_t slot = READ_BYTE();
+      PUSH(frame->slots[slot]);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_SET_LOCAL) : {
+      uint8_t slot = READ_BYTE();
+      frame->slots[slot] = PEEK(0);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GET_UPVALUE) : {
+      uint8_t index = READ_BYTE();
+      PUSH(*frame->closure->upvalues[index]->slot);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_SET_UPVALUE) : {
+      uint8_t index = READ_BYTE();
+      ObjUpvalue* upvalue = frame->closure->upvalues[index];
+      *upvalue->slot = PEEK(0);
+      // only matters once the upvalue is closed (an open one writes to
+      // the stack, which is a root), but the barrier's own filter is
+      // cheaper than distinguishing the two here.
+      gcWriteBarrier((Obj*)upvalue, PEEK(0));
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_JUMPZ) : {
+      uint16_t offset = READ_SHORT();
+      if (isFalsey(PEEK(0)))
+        frame->ip += offset;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_JUMP) : {
+      uint16_t offset = READ_SHORT();
+      frame->ip += offset;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_LOOP) : {
+      uint16_t offset = READ_SHORT();
+      frame->ip -= offset;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_CALL) : {
+      int argCount = READ_BYTE();
+      uint16_t cacheIndex = READ_SHORT();
+      InlineCache* cache = &frame->function->chunk.caches[cacheIndex];
+      Value callee = PEEK(argCount);
+
+      // fast path: the same callee (closure or bare function) as last
+      // time. Being the same object means the arity check already
+      // passed here once, so the frame can be pushed without going
+      // through callValue's type dispatch.
+      if (IS_OBJ(callee) && AS_OBJ(callee) == cache->callee) {
+        if (vm.frameCount == FRAMES_MAX) {
+          SAVE_STACK();
+          runtimeError("Stack overflow.");
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        ObjClosure* closure = NULL;
+        ObjFunction* function;
+        if (cache->callee->type == OBJ_CLOSURE) {
+          closure = (ObjClosure*)cache->callee;
+          function = closure->function;
+        } else {
+          function = (ObjFunction*)cache->callee;
+        }
+        SAVE_STACK();
+        reserveFrameSlots((size_t)(stackTop - vm.stack.values) - argCount - 1,
+                          function->maxStack);
+        RESTORE_STACK();
+        // like call(): publish the frame to the sampler only once its
+        // fields are written.
+        frame = &vm.frames[vm.frameCount];
+        frame->closure = closure;
+        frame->function = function;
+        frame->ip = function->chunk.code;
+        frame->slots = stackTop - argCount - 1;
+        SAMPLE_FENCE();
+        vm.frameCount++;
+        if (profileEnabled)
+          profileCall(function);
+        DISPATCH();
+      }
+
+      // natives push and pop through the ValueStack, so sync around
+      // the slow path.
+      SAVE_STACK();
+      if (!callValue(callee, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      RESTORE_STACK();
+      if (IS_OBJ(callee) && (OBJ_TYPE(callee) == OBJ_CLOSURE ||
+                             OBJ_TYPE(callee) == OBJ_FUNCTION)) {
+        cache->callee = AS_OBJ(callee);
+        // the cache lives in an old function's chunk; its callee is a
+        // raw pointer only the containing function's trace knows about.
+        gcWriteBarrier((Obj*)frame->function, callee);
+      }
+      frame = &vm.frames[vm.frameCount - 1];
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_TAIL_CALL) : {
+      int argCount = READ_BYTE();
+      uint16_t cacheIndex = READ_SHORT();
+      (void)cacheIndex;
+      Value callee = PEEK(argCount);
+
+      if (IS_OBJ(callee) && (OBJ_TYPE(callee) == OBJ_CLOSURE ||
+                             OBJ_TYPE(callee) == OBJ_FUNCTION)) {
+        ObjClosure* closure = NULL;
+        ObjFunction* function;
+        if (OBJ_TYPE(callee) == OBJ_CLOSURE) {
+          closure = AS_CLOSURE(callee);
+          function = closure->function;
+        } else {
+          function = AS_FUNCTION(callee);
+        }
+        if (function->arity != argCount) {
+          SAVE_STACK();
+          runtimeError("Expected %d arguments but got %d.", function->arity,
+                       argCount);
+          return INTERPRET_RUNTIME_ERROR;
+        }
+
+        // the departing frame's locals are about to be overwritten, so
+        // any upvalues still pointing into its window close now - the
+        // same thing OP_RETURN would have done.
+        closeUpvalues(frame->slots);
+        if (profileEnabled) {
+          profileReturn();
+          profileCall(function);
+        }
+
+        // frame->slots is rebased through vm.frames if the stack moves.
+        SAVE_STACK();
+        reserveFrameSlots((size_t)(frame->slots - vm.stack.values),
+                          function->maxStack);
+        RESTORE_STACK();
+
+        // slide callee + args down into the reused slot window and
+        // restart the loop in the callee: no new frame, no unwinding.
+        memmove(frame->slots, stackTop - argCount - 1,
+                sizeof(Value) * (argCount + 1));
+        stackTop = frame->slots + argCount + 1;
+        frame->closure = closure;
+        frame->function = function;
+        frame->ip = function->chunk.code;
+        DISPATCH();
+      }
+
+      // natives (and non-callables, which error out): an ordinary call
+      // whose result the following OP_RETURN hands back.
+      SAVE_STACK();
+      if (!callValue(callee, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      RESTORE_STACK();
+      frame = &vm.frames[vm.frameCount - 1];
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_CLOSURE) : {
+      ObjFunction* function = AS_FUNCTION(READ_CONSTANT());
+      SAVE_STACK();
+      ObjClosure* closure = newClosure(function);
+      RESTORE_STACK();
+      PUSH(OBJ_VAL(closure));
+      SAVE_STACK();
+      for (int i = 0; i < closure->upvalueCount; i++) {
+        uint8_t isLocal = READ_BYTE();
+        uint8_t index = READ_BYTE();
+        if (isLocal) {
+          closure->upvalues[i] = captureValue(frame->slots + index);
+        } else {
+          closure->upvalues[i] = frame->closure->upvalues[i];
+        }
+        // capturing can allocate, and a collection mid-loop can
+        // promote the half-filled closure out from under us.
+        gcWriteBarrier((Obj*)closure, OBJ_VAL(closure->upvalues[i]));
+      }
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_CLOSE_UPVALUE) : {
+      closeUpvalues(stackTop - 1);
+      stackTop--;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_DEFINE_GLOBAL_SLOT) : {
+      uint8_t slot = READ_BYTE();
+      vm.globalSlots.values[slot] = POP();
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GET_GLOBAL_SLOT) : {
+      uint8_t slot = READ_BYTE();
+      Value value = vm.globalSlots.values[slot];
+      if (IS_UNDEFINED(value)) {
+        SAVE_STACK();
+        runtimeError("Undefined global '%s'.", globalSlotName(slot)->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      PUSH(value);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_SET_GLOBAL_SLOT) : {
+      uint8_t slot = READ_BYTE();
+      if (IS_UNDEFINED(vm.globalSlots.values[slot])) {
+        SAVE_STACK();
+        runtimeError("Undefined variable '%s'.", globalSlotName(slot)->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      vm.globalSlots.values[slot] = PEEK(0);
+      DISPATCH();
+    }
+
+    // the fused comparisons compute exactly what the two-instruction
+    // sequences they replace did (negation of the base comparison).
+    CASE_CODE(OP_NOT_EQUAL) : {
+      // same rooting dance as OP_EQUAL.
+      SAVE_STACK();
+      bool equal = valuesEqual(PEEK(1), PEEK(0));
+      stackTop -= 2;
+      PUSH(BOOL_VAL(!equal));
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GREATER_EQUAL) : {
+      // written as !(a < b), not (a >= b): the two differ for NaN and
+      // the former is what OP_LESS + OP_NOT used to compute.
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+        SAVE_STACK();
+        runtimeError("Operands must be numbers.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      double b = AS_NUMBER(POP());
+      stackTop[-1] = BOOL_VAL(!(AS_NUMBER(stackTop[-1]) < b));
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_LESS_EQUAL) : {
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+        SAVE_STACK();
+        runtimeError("Operands must be numbers.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      double b = AS_NUMBER(POP());
+      stackTop[-1] = BOOL_VAL(!(AS_NUMBER(stackTop[-1]) > b));
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_ADD_CONST) : {
+      Value constant = READ_CONSTANT();
+      if (IS_NUMBER(PEEK(0)) && IS_NUMBER(constant)) {
+        stackTop[-1] = NUMBER_VAL(AS_NUMBER(stackTop[-1]) + AS_NUMBER(constant));
+      } else if (IS_STRINGLIKE(PEEK(0)) && IS_STRING(constant)) {
+        PUSH(constant);
+        SAVE_STACK();
+        concatenate();
+        RESTORE_STACK();
+      } else {
+        SAVE_STACK();
+        runtimeError("Operands must be two numbers or two strings.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_ARRAY) : {
+      int count = READ_BYTE();
+      SAVE_STACK();
+      ObjArray* array = newArray();
+      RESTORE_STACK();
+      // root the array over the appends below, each of which can
+      // allocate; the elements stay rooted on the stack beneath it.
+      PUSH(OBJ_VAL(array));
+      SAVE_STACK();
+      for (int i = 0; i < count; i++) {
+        writeValueArray(&array->elements, PEEK(count - i));
+      }
+      stackTop -= count + 1;
+      PUSH(OBJ_VAL(array));
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_INDEX_GET) : {
+      if (!IS_ARRAY(PEEK(1))) {
+        SAVE_STACK();
+        runtimeError("Can only index into arrays.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      if (!IS_NUMBER(PEEK(0))) {
+        SAVE_STACK();
+        runtimeError("Array index must be a number.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjArray* array = AS_ARRAY(PEEK(1));
+      int index = (int)AS_NUMBER(PEEK(0));
+      if (index < 0 || index >= array->elements.count) {
+        SAVE_STACK();
+        runtimeError("Array index %d out of bounds (length %d).", index,
+                     array->elements.count);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      stackTop -= 2;
+      PUSH(array->elements.values[index]);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_INDEX_SET) : {
+      if (!IS_ARRAY(PEEK(2))) {
+        SAVE_STACK();
+        runtimeError("Can only index into arrays.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      if (!IS_NUMBER(PEEK(1))) {
+        SAVE_STACK();
+        runtimeError("Array index must be a number.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjArray* array = AS_ARRAY(PEEK(2));
+      int index = (int)AS_NUMBER(PEEK(1));
+      if (index < 0 || index >= array->elements.count) {
+        SAVE_STACK();
+        runtimeError("Array index %d out of bounds (length %d).", index,
+                     array->elements.count);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      // assignment is an expression, so the stored value replaces the
+      // array/index/value triple as the result.
+      Value value = PEEK(0);
+      array->elements.values[index] = value;
+      gcWriteBarrier((Obj*)array, value);
+      stackTop -= 3;
+      PUSH(value);
+      DISPATCH();
+    }
+
+    // the long forms below mirror their byte-operand counterparts; the
+    // only difference is how many operand bytes the index occupies.
+    CASE_CODE(OP_CONSTANT_LONG) : {
+      Value constant = READ_CONSTANT_LONG();
+      PUSH(constant);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_DEFINE_GLOBAL_LONG) : {
+      ObjString* name = READ_STRING_LONG();
+      SAVE_STACK();
+      tableSet(&vm.globals, name, PEEK(0));
+      stackTop--;
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_GET_GLOBAL_LONG) : {
+      // unlike OP_GET_GLOBAL there's no inline cache here; sites only
+      // compile to this form past 256 slots and 256 names.
+      ObjString* name = READ_STRING_LONG();
+      Entry* entry = tableFindEntry(&vm.globals, name);
+      if (entry == NULL || entry->key == NULL) {
+        SAVE_STACK();
+        runtimeError("Undefined global '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      PUSH(entry->value);
+      DISPATCH();
+    }
+
+    CASE_CODE(OP_SET_GLOBAL_LONG) : {
+      ObjString* name = READ_STRING_LONG();
+      SAVE_STACK();
+      if (tableSet(&vm.globals, name, PEEK(0))) {
+        tableDelete(&vm.globals, name);
+        runtimeError("Undefined variable '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      DISPATCH();
+    }
+  }
+
+#undef READ_CONSTANT
+#undef READ_BYTE
+#undef READ_STRING
+#undef READ_SHORT
+#undef READ_CONSTANT_LONG
+#undef READ_STRING_LONG
+#undef BINARY_OP
+#undef CASE_CODE
+#undef DISPATCH
+#undef INTERPRET_LOOP
+#undef TRACE_EXECUTION
+#undef SAVE_STACK
+#undef RESTORE_STACK
+#undef PUSH
+#undef POP
+#undef PEEK
+}
+
+// runs an already-compiled script function; used both by interpret()
+// below and for functions deserialized from .loxb files.
+InterpretResult interpretCompiled(ObjFunction* function) {
+  // a fresh run starts outside any fiber; leftovers from a previous
+  // run (possible in the REPL) are garbage by now.
+  vm.fiber = NULL;
+  // the script captures nothing, so it runs as a bare function with no
+  // closure wrapper.
+  push(OBJ_VAL(function));
+  callValue(OBJ_VAL(function), 0);
+
+  return run();
+}
+
+InterpretResult interpret(const char* source) {
+  // the compiler puts all the bytecode
+  // into the chunk's opcode array
+  ObjFunction* function = compile(source);
+
+  if (function == NULL)
+    return INTERPRET_COMPILE_ERROR;
+
+  return interpretCompiled(function);
+}
+
+InterpretResult interpretLine(const char* source) {
+  // the interned source doubles as the cache key: an unchanged line is
+  // a pointer hit, an edited one compiles fresh under its new key.
+  ObjString* key = copyString(source, (int)strlen(source));
+  push(OBJ_VAL(key));
+
+  Value cached;
+  ObjFunction* function;
+  if (tableGet(&vm.replCache, key, &cached)) {
+    function = AS_FUNCTION(cached);
+  } else {
+    function = compile(source);
+    if (function == NULL) {
+      pop();
+      return INTERPRET_COMPILE_ERROR;
+    }
+    push(OBJ_VAL(function));
+    tableSet(&vm.replCache, key, OBJ_VAL(function));
+    pop();
+  }
+  pop();
+
+  InterpretResult result = interpretCompiled(function);
+  if (result != INTERPRET_OK) {
+    // runtimeError already reset the value stack; drop whatever frames
+    // and open upvalues the aborted run left behind so the session's
+    // next line starts clean.
+    vm.frameCount = 0;
+    vm.openUpvalues = NULL;
+    vm.fiber = NULL;
+  }
+  return result;
 }
\ No newline at end of file
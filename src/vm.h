@@ -1,53 +1,100 @@
-#ifndef clox_vm_h
-#define clox_vm_h
-
-#include "chunk.h"
-#include "object.h"
-#include "table.h"
-#include "value.h"
-
-#define FRAMES_MAX 64
-// initial stack size
-// grows further dynamically as values are added
-#define STACK_SIZE 256
-
-typedef struct {
-  ObjClosure* closure;
-  uint8_t* ip;
-  // the first slot that this function
-  // can use;
-  Value* slots;
-} CallFrame;
-
-/* stackTop points to where the next element is
- supposed to go. (points to an unused slot) */
-
-typedef struct {
-  CallFrame frames[FRAMES_MAX];
-  int frameCount;
-
-  ValueStack stack;
-  // Interned strings in the VM.
-  Table strings;
-  Obj* objects;
-  // global variables, ObjString* -> Value table
-  Table globals;
-  ObjUpvalue* openUpvalues;
-  int grayCount;
-  int grayCapacity;
-  Obj** grayStack;
-} VM;
-
-typedef enum {
-  INTERPRET_OK,
-  INTERPRET_RUNTIME_ERROR,
-  INTERPRET_COMPILE_ERROR
-} InterpretResult;
-
-VM vm;
-
-void initVM();
-void freeVM();
-InterpretResult interpret(const char* source);
-
+#ifndef clox_vm_h
+#define clox_vm_h
+
+#include "chunk.h"
+#include "object.h"
+#include "table.h"
+#include "value.h"
+
+// initial stack size
+// grows further dynamically as values are added
+#define STACK_SIZE 256
+
+/* stackTop points to where the next element is
+ supposed to go. (points to an unused slot) */
+
+typedef struct {
+  // the active fiber's call frames; FRAMES_MAX of them. A pointer (not
+  // an inline array) so fiber switches exchange frame stacks in O(1).
+  CallFrame* frames;
+  int frameCount;
+
+  ValueStack stack;
+  // Interned strings in the VM.
+  Table strings;
+  // the old generation: objects that survived a collection.
+  Obj* objects;
+  // the nursery: freshly allocated objects. Minor collections sweep
+  // only this list and promote survivors into `objects`.
+  Obj* youngObjects;
+  // global variables, ObjString* -> Value table.
+  // only used for late-bound names once the slot space is full;
+  // everything else goes through globalSlots.
+  Table globals;
+  // name -> slot index assignments, shared by every compile in this VM
+  // so REPL lines and cached chunks agree on the numbering.
+  Table globalNames;
+  // dense storage for slot-indexed globals. A slot holding
+  // UNDEFINED_VAL has been referenced but not defined yet.
+  ValueArray globalSlots;
+  // REPL fragment cache: source line -> compiled script function, so
+  // re-running an unchanged line skips the compiler entirely.
+  Table replCache;
+  ObjUpvalue* openUpvalues;
+  // the fiber whose stack and frames are loaded in the fields above;
+  // NULL until the script first resumes one (the main script is then
+  // adopted into a synthetic root fiber so it can be parked too).
+  ObjFiber* fiber;
+  int grayCount;
+  int grayCapacity;
+  Obj** grayStack;
+
+  // old objects the write barrier caught storing a reference to a
+  // young one since the last collection; minor collections re-trace
+  // just these instead of the whole old generation.
+  Obj** remembered;
+  int rememberedCount;
+  int rememberedCapacity;
+  // a minor collection is in progress: markObject treats the old
+  // generation as implicitly live.
+  bool gcMinor;
+
+  // GC pacing: a minor collection runs once youngBytes (allocation
+  // since the last collection) crosses the nursery size, a major one
+  // once bytesAllocated crosses nextGC, which is then recomputed from
+  // the live size after the sweep.
+  size_t bytesAllocated;
+  size_t youngBytes;
+  size_t nextGC;
+  // collection statistics, exposed to scripts through gcstats().
+  int gcCount;
+  int gcMinorCount;
+  double gcLastPauseMs;
+  double gcTotalPauseMs;
+} VM;
+
+typedef enum {
+  INTERPRET_OK,
+  INTERPRET_RUNTIME_ERROR,
+  INTERPRET_COMPILE_ERROR
+} InterpretResult;
+
+// the calling thread's isolate. Every thread owns an independent VM -
+// heap, GC, interned strings, globals - so initVM/interpret/freeVM on
+// different threads never touch each other's state. Objects must not
+// migrate between isolates: each heap is swept by its own collector.
+extern _Thread_local VM vm;
+
+void initVM();
+void freeVM();
+InterpretResult interpret(const char* source);
+InterpretResult interpretCompiled(ObjFunction* function);
+// interpret() for one REPL input: compiled fragments are cached in
+// vm.replCache and the VM is cleaned up after a runtime error so the
+// session can continue.
+InterpretResult interpretLine(const char* source);
+// returns the dense slot assigned to a global name, allocating one if
+// needed; -1 once the byte-sized slot space is exhausted.
+int globalSlot(ObjString* name);
+
 #endif
\ No newline at end of file